@@ -0,0 +1,189 @@
+/*
+ * Ascon-128 (Dobraunig, Eichlseder, Mendel, Schläffer; NIST lightweight cryptography winner).
+ * Plain 64-bit C after the reference implementation: only XOR, AND, NOT and rotations,
+ * no multiplications, which suits the Cortex-M0 of the buoy.
+ */
+
+#include "ascon_aead.h"
+
+#include <string.h>
+
+#define ASCON_128_IV 0x80400c0600000000ULL /* k=128, r=64, a=12, b=6 */
+#define ASCON_RATE 8
+#define ROUNDS_A 12
+#define ROUNDS_B 6
+
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+#define PAD(i) (0x80ULL << (56 - 8 * (i))) /* padding after i bytes of a block */
+
+/* Ascon loads its words big-endian, and blocks can be partial */
+static uint64_t load64(const uint8_t* p, size_t n)
+{
+    uint64_t x = 0;
+    size_t i;
+    for (i = 0; i < n; i++)
+        x |= (uint64_t)p[i] << (56 - 8 * i);
+    return x;
+}
+
+static void store64(uint8_t* p, size_t n, uint64_t x)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+        p[i] = (uint8_t)(x >> (56 - 8 * i));
+}
+
+static void permutation(uint64_t s[5], int rounds)
+{
+    uint64_t x0 = s[0], x1 = s[1], x2 = s[2], x3 = s[3], x4 = s[4];
+    uint64_t t0, t1, t2, t3, t4;
+    int r;
+
+    for (r = ROUNDS_A - rounds; r < ROUNDS_A; r++) {
+        /* round constant */
+        x2 ^= 0xf0 - r * 0x0f;
+        /* substitution layer */
+        x0 ^= x4;  x4 ^= x3;  x2 ^= x1;
+        t0 = ~x0 & x1;  t1 = ~x1 & x2;  t2 = ~x2 & x3;  t3 = ~x3 & x4;  t4 = ~x4 & x0;
+        x0 ^= t1;  x1 ^= t2;  x2 ^= t3;  x3 ^= t4;  x4 ^= t0;
+        x1 ^= x0;  x0 ^= x4;  x3 ^= x2;  x2 = ~x2;
+        /* linear diffusion layer */
+        x0 ^= ROR64(x0, 19) ^ ROR64(x0, 28);
+        x1 ^= ROR64(x1, 61) ^ ROR64(x1, 39);
+        x2 ^= ROR64(x2, 1) ^ ROR64(x2, 6);
+        x3 ^= ROR64(x3, 10) ^ ROR64(x3, 17);
+        x4 ^= ROR64(x4, 7) ^ ROR64(x4, 41);
+    }
+    s[0] = x0;  s[1] = x1;  s[2] = x2;  s[3] = x3;  s[4] = x4;
+}
+
+/* initialisation and associated data; leaves the state ready for the first text block */
+static void ascon_start(uint64_t s[5], uint64_t k0, uint64_t k1, uint64_t n0, uint64_t n1, const uint8_t* ad, size_t adlen)
+{
+    s[0] = ASCON_128_IV;  s[1] = k0;  s[2] = k1;  s[3] = n0;  s[4] = n1;
+    permutation(s, ROUNDS_A);
+    s[3] ^= k0;  s[4] ^= k1;
+
+    if (adlen > 0) {
+        for (; adlen >= ASCON_RATE; ad += ASCON_RATE, adlen -= ASCON_RATE) {
+            s[0] ^= load64(ad, ASCON_RATE);
+            permutation(s, ROUNDS_B);
+        }
+        s[0] ^= load64(ad, adlen) ^ PAD(adlen);
+        permutation(s, ROUNDS_B);
+    }
+    s[4] ^= 1; /* domain separation */
+}
+
+/* en- or decrypts len bytes (dest may be src) and writes the tag */
+static void ascon_core(uint64_t k0, uint64_t k1, uint64_t n0, uint64_t n1, const uint8_t* ad, size_t adlen,
+    uint8_t* dest, const uint8_t* src, size_t len, int is_encrypt, uint8_t tag[ASCON128_TAGLEN])
+{
+    uint64_t s[5], c;
+
+    ascon_start(s, k0, k1, n0, n1, ad, adlen);
+    for (; len >= ASCON_RATE; src += ASCON_RATE, dest += ASCON_RATE, len -= ASCON_RATE) {
+        c = load64(src, ASCON_RATE);
+        if (is_encrypt) {
+            s[0] ^= c;
+            store64(dest, ASCON_RATE, s[0]);
+        } else {
+            store64(dest, ASCON_RATE, s[0] ^ c);
+            s[0] = c;
+        }
+        permutation(s, ROUNDS_B);
+    }
+    c = load64(src, len);
+    if (is_encrypt) {
+        s[0] ^= c;
+        store64(dest, len, s[0]);
+    } else {
+        store64(dest, len, s[0] ^ c);
+        if (len > 0) s[0] = (s[0] & (~0ULL >> (8 * len))) | c;
+    }
+    s[0] ^= PAD(len);
+
+    s[1] ^= k0;  s[2] ^= k1;
+    permutation(s, ROUNDS_A);
+    store64(tag, 8, s[3] ^ k0);
+    store64(tag + 8, 8, s[4] ^ k1);
+}
+
+static int tag_differs(const uint8_t* a, const uint8_t* b)
+{
+    int i, r = 0;
+    for (i = 0; i < ASCON128_TAGLEN; i++)
+        r |= a[i] ^ b[i];
+    return r != 0;
+}
+
+int ascon128_aead(const uint8_t* key, const uint8_t* nonce, const uint8_t* ad, size_t adlen, uint8_t* dest, const uint8_t* src, size_t src_len, int is_encrypt)
+{
+    uint8_t tag[ASCON128_TAGLEN];
+
+    if (is_encrypt) {
+        ascon_core(load64(key, 8), load64(key + 8, 8), load64(nonce, 8), load64(nonce + 8, 8), ad, adlen,
+            dest, src, src_len, 1, dest + src_len);
+        return 0;
+    }
+    if (src_len < ASCON128_TAGLEN)
+        return -1;
+    src_len -= ASCON128_TAGLEN;
+    ascon_core(load64(key, 8), load64(key + 8, 8), load64(nonce, 8), load64(nonce + 8, 8), ad, adlen,
+        dest, src, src_len, 0, tag);
+    if (tag_differs(tag, src + src_len)) {
+        memset(dest, 0, src_len);
+        return -1;
+    }
+    return 0;
+}
+
+int ascon128_init(struct asconaead_ctx* ctx, const uint8_t* k, int k_len)
+{
+    if (k_len != ASCON128_KEY_LEN)
+        return -1;
+    ctx->k0 = load64(k, 8);
+    ctx->k1 = load64(k + 8, 8);
+    return 0;
+}
+
+int ascon128_crypt(struct asconaead_ctx* ctx, uint64_t seqnr, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t src_len, int is_encrypt)
+{
+    uint8_t tag[ASCON128_TAGLEN];
+
+    if (
+        // if we encrypt, make sure the source contains at least the length and the destination has space for the source + tag
+        (is_encrypt && (src_len < ASCON128_AAD_LEN || dest_len < src_len + ASCON128_TAGLEN)) ||
+        // if we decrypt, make sure the source contains at least the length + tag and the destination has space for the source - tag
+        (!is_encrypt && (src_len < ASCON128_AAD_LEN + ASCON128_TAGLEN || dest_len < src_len - ASCON128_TAGLEN))) {
+        return -1;
+    }
+
+    /* the 128 bit nonce is the sequence number, zero extended */
+    if (is_encrypt) {
+        ascon_core(ctx->k0, ctx->k1, seqnr, 0, NULL, 0, dest, src, src_len, 1, dest + src_len);
+        return 0;
+    }
+    src_len -= ASCON128_TAGLEN;
+    ascon_core(ctx->k0, ctx->k1, seqnr, 0, NULL, 0, dest, src, src_len, 0, tag);
+    if (tag_differs(tag, src + src_len)) {
+        memset(dest, 0, src_len);
+        return -1;
+    }
+    return 0;
+}
+
+int ascon128_get_length(struct asconaead_ctx* ctx,
+    uint32_t* len_out,
+    uint64_t seqnr,
+    const uint8_t* ciphertext)
+{
+    uint64_t s[5];
+
+    /* the length is the start of the first text block, so only the initialisation is needed */
+    ascon_start(s, ctx->k0, ctx->k1, seqnr, 0, NULL, 0);
+    *len_out = (ciphertext[0] ^ (uint8_t)(s[0] >> 56)) |
+               (ciphertext[1] ^ (uint8_t)(s[0] >> 48)) << 8 |
+               (ciphertext[2] ^ (uint8_t)(s[0] >> 40)) << 16;
+    return 0;
+}
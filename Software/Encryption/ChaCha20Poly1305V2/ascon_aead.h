@@ -0,0 +1,31 @@
+#ifndef ASCON_AEAD_H
+#define ASCON_AEAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Ascon-128 AEAD with the frame layout of chachapoly_aead.h: src starts with the
+ * 3 byte length, which is encrypted with the rest of the frame, and the 16 byte tag
+ * is appended. The nonce is the sequence number, so every frame needs a new seqnr.
+ */
+
+#define ASCON128_KEY_LEN 16
+#define ASCON128_TAGLEN 16
+#define ASCON128_AAD_LEN 3 /* 3 bytes length */
+#define ASCON128_FRAME_SUITE 0x80 /* frame header byte; ChaCha20-Poly1305 frames carry their rounds (8, 12, 20) */
+
+struct asconaead_ctx {
+    uint64_t k0, k1;
+};
+
+int ascon128_init(struct asconaead_ctx* ctx, const uint8_t* k, int k_len);
+int ascon128_crypt(struct asconaead_ctx* ctx, uint64_t seqnr, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t src_len, int is_encrypt);
+int ascon128_get_length(struct asconaead_ctx* ctx,
+    uint32_t* len_out,
+    uint64_t seqnr,
+    const uint8_t* ciphertext);
+
+/* Ascon-128 as specified, for the known-answer tests. dest gets mlen bytes of text plus the tag when encrypting */
+int ascon128_aead(const uint8_t* key, const uint8_t* nonce, const uint8_t* ad, size_t adlen, uint8_t* dest, const uint8_t* src, size_t src_len, int is_encrypt);
+#endif /* ASCON_AEAD_H */
@@ -1,9 +1,24 @@
 #include "sys/time.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
+#include "ascon_aead.h"
 #include "chachapoly_aead.h"
+#include "lzss_block.h"
 #include "poly1305.h"
+#include "siphash.h"
 
 static const uint8_t testkey[32] = {
     0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
@@ -33,6 +48,30 @@ static double gettimedouble(void)
     return tv.tv_usec * 0.000001 + tv.tv_sec;
 }
 
+/* cycle counter (rdtsc) on x86, nanoseconds elsewhere */
+#if defined(__x86_64__) || defined(__i386__)
+static const char* cycle_unit = "cycles";
+static uint64_t gettimecycles(void)
+{
+    return __rdtsc();
+}
+#elif defined(CLOCK_MONOTONIC)
+static const char* cycle_unit = "ns";
+static uint64_t gettimecycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#else
+/* newlib (the bare-metal Cortex-M0 build) has no clock_gettime() */
+static const char* cycle_unit = "ns";
+static uint64_t gettimecycles(void)
+{
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+}
+#endif
+
 static void print_number(double x)
 {
     double y = x;
@@ -81,6 +120,31 @@ static void run_benchmark(char* name, void (*benchmark)(void*), void (*setup)(vo
     printf("ns\n");
 }
 
+/* like run_benchmark, but in cycles for each of the n units (bytes, frames) one call of benchmark processes.
+   Returns the minimum per unit */
+static double run_benchmark_cycles(char* name, void (*benchmark)(void*), void* data, int count, uint64_t n, const char* per)
+{
+    int i;
+    uint64_t min = UINT64_MAX;
+    uint64_t sum = 0;
+    for (i = 0; i < count; i++) {
+        uint64_t begin = gettimecycles();
+        uint64_t total;
+        benchmark(data);
+        total = gettimecycles() - begin;
+        if (total < min) {
+            min = total;
+        }
+        sum += total;
+    }
+    printf("%s: min ", name);
+    print_number((double)min / n);
+    printf("%s/%s / avg ", cycle_unit, per);
+    print_number((double)sum / count / n);
+    printf("%s/%s\n", cycle_unit, per);
+    return (double)min / n;
+}
+
 static void bench_chacha_ivsetup(void* data)
 {
     struct chacha_ctx* ctx = (struct chacha_ctx*)data;
@@ -109,14 +173,25 @@ static void bench_chacha_encrypt(void* data)
     }
 }
 
-static void bench_poly1305_auth(void* data)
+/* whole 64 byte blocks, so the cost per byte is the cost of the rounds */
+static void bench_chacha_encrypt_blocks(void* data)
 {
     struct chacha_ctx* ctx = (struct chacha_ctx*)data;
+    uint8_t scratch[CHACHA_BLOCKLEN] = {0};
+    int i;
+    for (i = 0; i < 4000000 / CHACHA_BLOCKLEN; i++) {
+        chacha_encrypt_bytes(ctx, scratch, scratch, CHACHA_BLOCKLEN);
+    }
+}
+
+static void bench_poly1305_auth(void* data)
+{
     uint8_t poly1305_tag[16] = {0};
     int i;
     for (i = 0; i < 4000000 / 12; i++) {
         poly1305_auth(poly1305_tag, testdata, 12, testkey);
     }
+    (void)data; /* poly1305_auth() takes no context */
 }
 
 static void bench_chacha20poly1305_init(void* data)
@@ -140,10 +215,60 @@ static void bench_chacha20poly1305_crypt(void* data)
     }
 }
 
-int main(void)
+/* buoy frames: a few readings, one compressed block of 10 readings, the firmware's largest block */
+static const size_t frame_sizes[] = {64, 200, 500};
+#define FRAME_ITERS 10000
+
+struct frame_bench {
+    struct chachapolyaead_ctx chachapoly;
+    struct asconaead_ctx ascon;
+    struct siphash_ctx siphash;
+    size_t len;
+};
+
+static void bench_frame_chachapoly(void* data)
+{
+    struct frame_bench* fb = (struct frame_bench*)data;
+    uint8_t buffer[512 + POLY1305_TAGLEN] = {0};
+    uint64_t seqnr;
+    for (seqnr = 0; seqnr < FRAME_ITERS; seqnr++) {
+        chacha20poly1305_crypt(&fb->chachapoly, seqnr, seqnr / AAD_PACKAGES_PER_ROUND,
+            (seqnr % AAD_PACKAGES_PER_ROUND) * CHACHA20_POLY1305_AEAD_AAD_LEN, buffer, sizeof(buffer), buffer, fb->len, 1);
+    }
+}
+
+static void bench_frame_ascon(void* data)
+{
+    struct frame_bench* fb = (struct frame_bench*)data;
+    uint8_t buffer[512 + ASCON128_TAGLEN] = {0};
+    uint64_t seqnr;
+    for (seqnr = 0; seqnr < FRAME_ITERS; seqnr++) {
+        ascon128_crypt(&fb->ascon, seqnr, buffer, sizeof(buffer), buffer, fb->len, 1);
+    }
+}
+
+/* MAC-only frames: nothing is encrypted, the data is only tagged */
+static void bench_frame_siphash(void* data)
+{
+    struct frame_bench* fb = (struct frame_bench*)data;
+    uint8_t buffer[512 + SIPHASH_TAGLEN] = {0};
+    uint64_t seqnr;
+    for (seqnr = 0; seqnr < FRAME_ITERS; seqnr++) {
+        siphash24_mac_crypt(&fb->siphash, seqnr, buffer, sizeof(buffer), buffer, fb->len, 1);
+    }
+}
+
+/* the primitive benchmarks (bench without options) */
+static void run_micro_benchmarks(void)
 {
     struct chacha_ctx ctx_chacha;
     struct chachapolyaead_ctx aead_ctx;
+    struct frame_bench frames;
+    static const int rounds[] = {8, 12, 20};
+    char name[64];
+    unsigned int i;
+
+    chacha_keysetup(&ctx_chacha, testkey, 256);
     run_benchmark("chacha_ivsetup", bench_chacha_ivsetup, NULL, NULL, &ctx_chacha,
         20, 50000);
     run_benchmark("chacha_keysetup", bench_chacha_keysetup, NULL, NULL,
@@ -156,5 +281,926 @@ int main(void)
         NULL, &aead_ctx, 20, 4000000);
     run_benchmark("chacha20poly1305_crypt 1MB", bench_chacha20poly1305_crypt,
         NULL, NULL, &aead_ctx, 20, 30);
+
+    /* reduced-round profiles: the same work at ChaCha8, ChaCha12 and ChaCha20 */
+    for (i = 0; i < sizeof(rounds) / sizeof(rounds[0]); i++) {
+        chacha_keysetup(&ctx_chacha, testkey, 256);
+        chacha_roundsetup(&ctx_chacha, rounds[i]);
+        chacha_ivsetup(&ctx_chacha, testnonce, NULL);
+        sprintf(name, "chacha%d_encrypt", rounds[i]);
+        run_benchmark_cycles(name, bench_chacha_encrypt_blocks, &ctx_chacha, 20, 4000000, "byte");
+    }
+    for (i = 0; i < sizeof(rounds) / sizeof(rounds[0]); i++) {
+        chacha20poly1305_init(&aead_ctx, aead_keys, 32, aead_keys + 32, 32);
+        chacha20poly1305_set_rounds(&aead_ctx, rounds[i]);
+        sprintf(name, "chacha%dpoly1305_crypt 1MB", rounds[i]);
+        run_benchmark_cycles(name, bench_chacha20poly1305_crypt, &aead_ctx, 5, 30 * BUFFER_SIZE, "byte");
+    }
+
+    /* ChaCha20-Poly1305, Ascon-128 and the MAC-only SipHash-2-4 frame side by side at buoy frame sizes */
+    chacha20poly1305_init(&frames.chachapoly, aead_keys, 32, aead_keys + 32, 32);
+    ascon128_init(&frames.ascon, aead_keys, ASCON128_KEY_LEN);
+    siphash24_mac_init(&frames.siphash, aead_keys, SIPHASH_KEY_LEN);
+    for (i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]); i++) {
+        double chachapoly_frame, ascon_frame, siphash_frame;
+
+        frames.len = frame_sizes[i];
+        sprintf(name, "chacha20poly1305 %dB frame", (int)frames.len);
+        chachapoly_frame = run_benchmark_cycles(name, bench_frame_chachapoly, &frames, 20, FRAME_ITERS, "frame");
+        run_benchmark_cycles(name, bench_frame_chachapoly, &frames, 20, FRAME_ITERS * frames.len, "byte");
+        sprintf(name, "ascon128 %dB frame", (int)frames.len);
+        ascon_frame = run_benchmark_cycles(name, bench_frame_ascon, &frames, 20, FRAME_ITERS, "frame");
+        run_benchmark_cycles(name, bench_frame_ascon, &frames, 20, FRAME_ITERS * frames.len, "byte");
+        sprintf(name, "siphash24 mac-only %dB frame", (int)frames.len);
+        siphash_frame = run_benchmark_cycles(name, bench_frame_siphash, &frames, 20, FRAME_ITERS, "frame");
+        run_benchmark_cycles(name, bench_frame_siphash, &frames, 20, FRAME_ITERS * frames.len, "byte");
+        printf("%dB frame cost relative to chacha20poly1305_crypt: ascon128 %.2f, siphash24 mac-only %.2f\n",
+            (int)frames.len, ascon_frame / chachapoly_frame, siphash_frame / chachapoly_frame);
+    }
+}
+
+/*
+ * Pipeline suite (bench --csv / bench --json): every stage of the buoy pipeline timed over
+ * whole datasets from Testing/, cut into blocks like the compress-then-seal tool does.
+ * Each stage is run once to warm up and then reps times, in rounds of every stage (see
+ * run_stages_timed()); the fastest run is reported.
+ */
+
+#define SUITE_MAX_REPS 100
+#define SUITE_DEFAULT_REPS 5
+#define SUITE_DEFAULT_BLOCK 4096
+#define SUITE_DEFAULT_MAX_BYTES (256 * 1024) /* of every dataset, to keep a run short */
+
+/* relative to this directory, like the paths in the READMEs */
+static const char* default_datasets[] = {
+    "../../../Testing/Simulation Data/Cleaned Data/STM32ArrayData.csv",
+    "../../../Testing/Simulation Data/Cleaned Data/Walking Around Example Data.csv",
+    "../../../Testing/Demo Test Data/Filtered Data/AllData1.txt",
+    "../../../Testing/Scripts/Acc1.txt",
+    "../../../Testing/Scripts/Gyro1.txt"};
+
+struct dataset {
+    const char* name; /* file name without the directories */
+    uint8_t* data;
+    size_t len;
+    /* outputs of the encoding stages, which are the inputs of the decoding stages */
+    uint8_t* lzss;
+    int* lzss_block_len;
+    uint8_t* sealed;
+    size_t sealed_len;
+    uint8_t* frame; /* one opened frame */
+    uint8_t* text;  /* len bytes */
+};
+
+struct suite_stage {
+    const char* name;
+    size_t (*run)(struct dataset*); /* returns the bytes it produced */
+};
+
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_BRANCH_MISSES, PERF_L1D_MISSES, PERF_COUNTERS }; /* --perf */
+
+struct suite_result {
+    const char* stage;
+    const char* dataset;
+    uint64_t bytes_in, bytes_out;
+    int reps;
+    double ns[SUITE_MAX_REPS];        /* per run */
+    double cycles[SUITE_MAX_REPS];    /* per run */
+    uint64_t counters[PERF_COUNTERS]; /* summed over the runs */
+};
+
+static size_t suite_block = SUITE_DEFAULT_BLOCK;
+static struct chacha_ctx suite_chacha;
+static struct chachapolyaead_ctx suite_aead;
+static struct asconaead_ctx suite_ascon;
+static struct siphash_ctx suite_siphash;
+
+static double gettimens(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000.0 + ts.tv_nsec;
+#else
+    return clock() * (1000000000.0 / CLOCKS_PER_SEC);
+#endif
+}
+
+#define FOR_EACH_BLOCK(d, off, blen) \
+    for (off = 0; off < (d)->len && ((blen) = (d)->len - off < suite_block ? (d)->len - off : suite_block); off += (blen))
+
+/* the firmware's RSA (main.c): every byte to the power e = 3, modulo n = 187 */
+static uint8_t rsa_byte(uint8_t m)
+{
+    return (uint8_t)((unsigned)m * m % 187 * m % 187);
+}
+
+static size_t stage_lzss_encode(struct dataset* d)
+{
+    size_t off, blen, pos = 0;
+    int b = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        d->lzss_block_len[b] = lzss_encode(d->data + off, blen, d->lzss + pos, LZSS_MAX_ENCODED(blen));
+        pos += d->lzss_block_len[b++];
+    }
+    return pos;
+}
+
+static size_t stage_lzss_decode(struct dataset* d)
+{
+    size_t off, blen, pos = 0, out = 0;
+    int b = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        out += lzss_decode(d->lzss + pos, d->lzss_block_len[b], d->text + off, blen);
+        pos += d->lzss_block_len[b++];
+    }
+    return out;
+}
+
+static size_t stage_rsa(struct dataset* d)
+{
+    size_t i;
+    for (i = 0; i < d->len; i++)
+        d->text[i] = rsa_byte(d->data[i]);
+    return d->len;
+}
+
+static size_t stage_chacha20(struct dataset* d)
+{
+    chacha_ivsetup(&suite_chacha, testnonce, NULL);
+    chacha_encrypt_bytes(&suite_chacha, d->data, d->text, d->len);
+    return d->len;
+}
+
+static size_t stage_poly1305(struct dataset* d)
+{
+    size_t off, blen, out = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        poly1305_auth(d->frame, d->data + off, blen, testkey);
+        out += POLY1305_TAGLEN;
+    }
+    return out;
+}
+
+static int suite_crypt(uint64_t seqnr, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t src_len, int is_encrypt)
+{
+    return chacha20poly1305_crypt(&suite_aead, seqnr, seqnr / AAD_PACKAGES_PER_ROUND,
+        (seqnr % AAD_PACKAGES_PER_ROUND) * CHACHA20_POLY1305_AEAD_AAD_LEN, dest, dest_len, src, src_len, is_encrypt);
+}
+
+/* seals body_len bytes already at frame + 3 */
+static size_t seal_frame(uint64_t seqnr, uint8_t* frame, size_t body_len)
+{
+    frame[0] = body_len & 0xff;
+    frame[1] = (body_len >> 8) & 0xff;
+    frame[2] = (body_len >> 16) & 0xff;
+    suite_crypt(seqnr, frame, CHACHA20_POLY1305_AEAD_AAD_LEN + body_len + POLY1305_TAGLEN,
+        frame, CHACHA20_POLY1305_AEAD_AAD_LEN + body_len, 1);
+    return CHACHA20_POLY1305_AEAD_AAD_LEN + body_len + POLY1305_TAGLEN;
+}
+
+/* opens the frame at pos into d->frame and returns its body length */
+static uint32_t open_frame(struct dataset* d, uint64_t seqnr, size_t pos)
+{
+    uint32_t body_len;
+    chacha20poly1305_get_length(&suite_aead, &body_len, seqnr, d->sealed + pos);
+    if (suite_crypt(seqnr, d->frame, CHACHA20_POLY1305_AEAD_AAD_LEN + body_len, d->sealed + pos,
+            CHACHA20_POLY1305_AEAD_AAD_LEN + body_len + POLY1305_TAGLEN, 0) != 0) {
+        fprintf(stderr, "%s: frame %llu does not open\n", d->name, (unsigned long long)seqnr);
+        exit(1);
+    }
+    return body_len;
+}
+
+static size_t stage_aead_seal(struct dataset* d)
+{
+    size_t off, blen, pos = 0;
+    uint64_t seqnr = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        memcpy(d->sealed + pos + CHACHA20_POLY1305_AEAD_AAD_LEN, d->data + off, blen);
+        pos += seal_frame(seqnr++, d->sealed + pos, blen);
+    }
+    return d->sealed_len = pos;
+}
+
+static size_t stage_aead_open(struct dataset* d)
+{
+    size_t pos = 0, out = 0;
+    uint64_t seqnr = 0;
+    while (pos < d->sealed_len) {
+        uint32_t body_len = open_frame(d, seqnr++, pos);
+        out += body_len;
+        pos += CHACHA20_POLY1305_AEAD_AAD_LEN + body_len + POLY1305_TAGLEN;
+    }
+    return out;
+}
+
+/* the compress-then-seal tool: LZSS, then one ChaCha20-Poly1305 frame per block */
+static size_t stage_pipeline_seal(struct dataset* d)
+{
+    size_t off, blen, pos = 0;
+    uint64_t seqnr = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        int codelen = lzss_encode(d->data + off, blen, d->sealed + pos + CHACHA20_POLY1305_AEAD_AAD_LEN, LZSS_MAX_ENCODED(blen));
+        pos += seal_frame(seqnr++, d->sealed + pos, codelen);
+    }
+    return d->sealed_len = pos;
+}
+
+static size_t stage_pipeline_open(struct dataset* d)
+{
+    size_t pos = 0, out = 0;
+    uint64_t seqnr = 0;
+    while (pos < d->sealed_len) {
+        uint32_t body_len = open_frame(d, seqnr++, pos);
+        out += lzss_decode(d->frame + CHACHA20_POLY1305_AEAD_AAD_LEN, body_len, d->text + out, d->len - out);
+        pos += CHACHA20_POLY1305_AEAD_AAD_LEN + body_len + POLY1305_TAGLEN;
+    }
+    return out;
+}
+
+/* the firmware's original path: RSA on every byte, then LZSS */
+static size_t stage_pipeline_rsa(struct dataset* d)
+{
+    size_t off, blen, pos = 0;
+    stage_rsa(d);
+    FOR_EACH_BLOCK(d, off, blen) {
+        pos += lzss_encode(d->text + off, blen, d->lzss + pos, LZSS_MAX_ENCODED(blen));
+    }
+    return pos;
+}
+
+/* in order: the decoding stages read what the stage before them wrote */
+static const struct suite_stage suite_stages[] = {
+    {"lzss_encode", stage_lzss_encode},
+    {"lzss_decode", stage_lzss_decode},
+    {"rsa", stage_rsa},
+    {"chacha20", stage_chacha20},
+    {"poly1305", stage_poly1305},
+    {"aead_seal", stage_aead_seal},
+    {"aead_open", stage_aead_open},
+    {"pipeline_rsa", stage_pipeline_rsa},
+    {"pipeline_seal", stage_pipeline_seal},
+    {"pipeline_open", stage_pipeline_open}};
+
+#define SUITE_STAGES (sizeof(suite_stages) / sizeof(suite_stages[0]))
+
+static int load_dataset(struct dataset* d, const char* path, size_t max_bytes)
+{
+    FILE* f = fopen(path, "rb");
+    size_t blocks, frame_max = CHACHA20_POLY1305_AEAD_AAD_LEN + LZSS_MAX_ENCODED(suite_block) + POLY1305_TAGLEN;
+    const char* slash = strrchr(path, '/');
+
+    memset(d, 0, sizeof(*d));
+    if (f == NULL)
+        return -1;
+    d->name = slash != NULL ? slash + 1 : path;
+    d->data = malloc(max_bytes);
+    d->len = d->data != NULL ? fread(d->data, 1, max_bytes, f) : 0;
+    fclose(f);
+    if (d->len == 0)
+        return -1;
+    blocks = (d->len + suite_block - 1) / suite_block;
+    d->lzss = malloc(blocks * LZSS_MAX_ENCODED(suite_block));
+    d->lzss_block_len = malloc(blocks * sizeof(int));
+    d->sealed = malloc(blocks * frame_max);
+    d->frame = malloc(frame_max);
+    d->text = malloc(d->len);
+    if (d->lzss == NULL || d->lzss_block_len == NULL || d->sealed == NULL || d->frame == NULL || d->text == NULL)
+        return -1;
+    return 0;
+}
+
+static void free_dataset(struct dataset* d)
+{
+    free(d->data);
+    free(d->lzss);
+    free(d->lzss_block_len);
+    free(d->sealed);
+    free(d->frame);
+    free(d->text);
+}
+
+/*
+ * Hardware counters (--perf, Linux only): cycles, instructions, branch misses and L1D read
+ * misses in user space, summed over the timed runs of a stage. A counter the CPU or the kernel
+ * does not offer (perf_event_paranoid, most virtual machines) is left out of the output.
+ */
+
+static const char* perf_names[PERF_COUNTERS] = {"cycles", "instructions", "branch-misses", "L1D read misses"};
+static int perf_fd[PERF_COUNTERS] = {-1, -1, -1, -1};
+static int suite_perf; /* --perf */
+
+#if defined(__linux__)
+/* returns the number of counters that could be opened */
+static int perf_open(void)
+{
+    static const uint32_t type[PERF_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+    static const uint64_t config[PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16};
+    int i, n = 0;
+
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type[i];
+        attr.config = config[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        perf_fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (perf_fd[i] < 0)
+            perror(perf_names[i]);
+        else
+            n++;
+    }
+    return n;
+}
+
+static void perf_start(void)
+{
+    int i;
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        if (perf_fd[i] >= 0) {
+            ioctl(perf_fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/* adds the counts since perf_start() */
+static void perf_stop(uint64_t counters[PERF_COUNTERS])
+{
+    uint64_t count;
+    int i;
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        if (perf_fd[i] >= 0) {
+            ioctl(perf_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(perf_fd[i], &count, sizeof(count)) == sizeof(count))
+                counters[i] += count;
+        }
+    }
+}
+#else
+static int perf_open(void)
+{
+    fprintf(stderr, "hardware counters need Linux perf_event_open\n");
+    return 0;
+}
+
+static void perf_start(void) {}
+static void perf_stop(uint64_t counters[PERF_COUNTERS]) { (void)counters; }
+#endif
+
+/*
+ * Runs every stage once to warm up, then reps rounds of every stage in order. A round holds
+ * one run of each stage, so a slow spell of the machine (another process, a clock change)
+ * spreads over the runs of all the stages instead of shifting every run of one.
+ */
+static void run_stages_timed(const struct suite_stage* stages, int nstages, struct dataset* d, int reps, struct suite_result* r)
+{
+    int i, j;
+
+    for (j = 0; j < nstages; j++) {
+        r[j].stage = stages[j].name;
+        r[j].dataset = d->name;
+        r[j].bytes_in = d->len;
+        r[j].reps = reps;
+        stages[j].run(d); /* warm up, and the input of the next stage */
+    }
+    for (i = 0; i < reps; i++) {
+        for (j = 0; j < nstages; j++) {
+            double begin = gettimens();
+            uint64_t begin_cycles = gettimecycles();
+            if (suite_perf)
+                perf_start();
+            r[j].bytes_out = stages[j].run(d);
+            if (suite_perf)
+                perf_stop(r[j].counters);
+            r[j].cycles[i] = gettimecycles() - begin_cycles;
+            r[j].ns[i] = gettimens() - begin;
+        }
+    }
+}
+
+/* IPC, instructions, branch misses and L1D misses per byte; empty (CSV) or null (JSON) without the counter */
+static void print_perf(const struct suite_result* r, int json)
+{
+    static const char* csv_names[] = {"ipc", "instructions_per_byte", "branch_misses_per_byte", "l1d_misses_per_byte"};
+    double bytes = (double)r->bytes_in * r->reps;
+    double value[4];
+    int have[4], i;
+
+    have[0] = perf_fd[PERF_CYCLES] >= 0 && perf_fd[PERF_INSTRUCTIONS] >= 0 && r->counters[PERF_CYCLES] > 0;
+    value[0] = have[0] ? (double)r->counters[PERF_INSTRUCTIONS] / r->counters[PERF_CYCLES] : 0;
+    for (i = 1; i < 4; i++) {
+        have[i] = perf_fd[i] >= 0;
+        value[i] = r->counters[i] / bytes;
+    }
+    for (i = 0; i < 4; i++) {
+        if (json && have[i])
+            printf(", \"%s\": %.4f", csv_names[i], value[i]);
+        else if (json)
+            printf(", \"%s\": null", csv_names[i]);
+        else if (have[i])
+            printf(",%.4f", value[i]);
+        else
+            printf(",");
+    }
+}
+
+static double min_of(const double* x, int n)
+{
+    double m = x[0];
+    int i;
+    for (i = 1; i < n; i++)
+        if (x[i] < m)
+            m = x[i];
+    return m;
+}
+
+static void print_csv(const struct suite_result* r, int n)
+{
+    int i;
+    printf("stage,dataset,bytes,out_bytes,ratio,ns_per_byte,%s_per_byte,reps%s\n", cycle_unit,
+        suite_perf ? ",ipc,instructions_per_byte,branch_misses_per_byte,l1d_misses_per_byte" : "");
+    for (i = 0; i < n; i++) {
+        printf("%s,%s,%llu,%llu,%.4f,%.3f,%.3f,%d", r[i].stage, r[i].dataset,
+            (unsigned long long)r[i].bytes_in, (unsigned long long)r[i].bytes_out,
+            (double)r[i].bytes_out / r[i].bytes_in, min_of(r[i].ns, r[i].reps) / r[i].bytes_in,
+            min_of(r[i].cycles, r[i].reps) / r[i].bytes_in, r[i].reps);
+        if (suite_perf)
+            print_perf(&r[i], 0);
+        printf("\n");
+    }
+}
+
+static void print_json(const struct suite_result* r, int n)
+{
+    int i;
+    printf("{\n  \"block\": %zu,\n  \"cycle_unit\": \"%s\",\n  \"results\": [\n", suite_block, cycle_unit);
+    for (i = 0; i < n; i++) {
+        printf("    {\"stage\": \"%s\", \"dataset\": \"%s\", \"bytes\": %llu, \"out_bytes\": %llu, "
+               "\"ratio\": %.4f, \"ns_per_byte\": %.3f, \"cycles_per_byte\": %.3f, \"reps\": %d",
+            r[i].stage, r[i].dataset, (unsigned long long)r[i].bytes_in, (unsigned long long)r[i].bytes_out,
+            (double)r[i].bytes_out / r[i].bytes_in, min_of(r[i].ns, r[i].reps) / r[i].bytes_in,
+            min_of(r[i].cycles, r[i].reps) / r[i].bytes_in, r[i].reps);
+        if (suite_perf)
+            print_perf(&r[i], 1);
+        printf("}%s\n", i + 1 < n ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+/*
+ * Baselines (bench --save-baseline file / bench --compare file): a baseline keeps the ns/byte
+ * of every run, one line per stage and dataset:
+ *   # bench baseline, block 4096
+ *   stage,dataset,bytes,reps,ns_per_byte run 1,...,ns_per_byte run reps
+ * --compare re-runs the suite and reports the change of the mean with a 95% confidence
+ * interval (Welch's t), and the change of the median with a noise floor: the spread of the
+ * middle 80% of the runs relative to their median, of the baseline or of the new runs,
+ * whichever is larger. A stage regresses only when the low end of the interval is above 0
+ * and the change of the median is above both the threshold and the noise floor, so a few
+ * slow runs, or a stage that is noisy on this machine, do not fail the gate by themselves.
+ */
+
+#define BASELINE_LINE_MAX (64 + 2 * 256 + SUITE_MAX_REPS * 24)
+#define BASELINE_DEFAULT_REPS 20 /* --save-baseline and --compare, unless --reps is given */
+#define DEFAULT_THRESHOLD 5.0 /* percent, of the median */
+#define EXIT_REGRESSION 2
+
+struct baseline {
+    char stage[64];
+    char dataset[256];
+    uint64_t bytes;
+    int reps;
+    double ns_per_byte[SUITE_MAX_REPS];
+};
+
+static int save_baseline(const char* path, const struct suite_result* r, int n)
+{
+    FILE* f = fopen(path, "w");
+    int i, j;
+    if (f == NULL)
+        return -1;
+    fprintf(f, "# bench baseline, block %zu\n", suite_block);
+    for (i = 0; i < n; i++) {
+        fprintf(f, "%s,%s,%llu,%d", r[i].stage, r[i].dataset, (unsigned long long)r[i].bytes_in, r[i].reps);
+        for (j = 0; j < r[i].reps; j++)
+            fprintf(f, ",%.4f", r[i].ns[j] / r[i].bytes_in);
+        fprintf(f, "\n");
+    }
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/* returns the number of entries read, -1 if the file does not open or is malformed */
+static int load_baseline(const char* path, struct baseline* b, int max, size_t* block)
+{
+    FILE* f = fopen(path, "r");
+    char line[BASELINE_LINE_MAX];
+    int n = 0, j;
+
+    if (f == NULL)
+        return -1;
+    *block = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *field, *save;
+        if (line[0] == '#') {
+            sscanf(line, "# bench baseline, block %zu", block);
+            continue;
+        }
+        if (n == max || (field = strtok_r(line, ",", &save)) == NULL)
+            break;
+        memset(&b[n], 0, sizeof(b[n]));
+        snprintf(b[n].stage, sizeof(b[n].stage), "%s", field);
+        if ((field = strtok_r(NULL, ",", &save)) == NULL)
+            break;
+        snprintf(b[n].dataset, sizeof(b[n].dataset), "%s", field);
+        if ((field = strtok_r(NULL, ",", &save)) == NULL)
+            break;
+        b[n].bytes = strtoull(field, NULL, 10);
+        if ((field = strtok_r(NULL, ",", &save)) == NULL)
+            break;
+        b[n].reps = atoi(field);
+        if (b[n].reps < 2 || b[n].reps > SUITE_MAX_REPS)
+            break;
+        for (j = 0; j < b[n].reps && (field = strtok_r(NULL, ",\n", &save)) != NULL; j++)
+            b[n].ns_per_byte[j] = atof(field);
+        if (j < b[n].reps)
+            break;
+        n++;
+    }
+    if (!feof(f))
+        n = -1;
+    fclose(f);
+    return n;
+}
+
+static void mean_var(const double* x, int n, double scale, double* mean, double* var)
+{
+    double sum = 0.0, sq = 0.0;
+    int i;
+    for (i = 0; i < n; i++)
+        sum += x[i] * scale;
+    *mean = sum / n;
+    for (i = 0; i < n; i++)
+        sq += (x[i] * scale - *mean) * (x[i] * scale - *mean);
+    *var = sq / (n - 1);
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* q-quantile of x[0..n-1] times scale, by linear interpolation; n <= SUITE_MAX_REPS */
+static double quantile(const double* x, int n, double scale, double q)
+{
+    double s[SUITE_MAX_REPS], pos = q * (n - 1);
+    int i = (int)pos;
+    memcpy(s, x, n * sizeof(*s));
+    qsort(s, n, sizeof(*s), cmp_double);
+    if (i + 1 >= n)
+        return s[n - 1] * scale;
+    return (s[i] + (pos - i) * (s[i + 1] - s[i])) * scale;
+}
+
+/* the 10% to 90% spread of x[0..n-1] relative to its median, in percent */
+static double spread(const double* x, int n)
+{
+    return (quantile(x, n, 1.0, 0.9) - quantile(x, n, 1.0, 0.1)) / quantile(x, n, 1.0, 0.5) * 100.0;
+}
+
+/* two-sided 95% quantile of Student's t */
+static double t_quantile_95(double df)
+{
+    static const double t[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1.0)
+        return t[0];
+    if (df <= 30.0)
+        return t[(int)df - 1];
+    return 1.96 + 2.46 / df;
+}
+
+/* prints the comparison and returns the number of regressions */
+static int compare_baseline(const struct baseline* b, int nb, const struct suite_result* r, int n, double threshold)
+{
+    int i, j, regressions = 0, missing = 0;
+
+    printf("%-14s %-32s %21s %21s %8s %19s %8s %6s\n", "stage", "dataset", "baseline ns/byte", "current ns/byte", "change", "95% CI",
+        "median", "noise");
+    for (i = 0; i < n; i++) {
+        double mb, vb, mc, vc, se2, df, t, diff, lo, hi, medb, medc, median, noise;
+        int regressed;
+        const struct baseline* base = NULL;
+
+        for (j = 0; j < nb && base == NULL; j++)
+            if (strcmp(b[j].stage, r[i].stage) == 0 && strcmp(b[j].dataset, r[i].dataset) == 0 && b[j].bytes == r[i].bytes_in)
+                base = &b[j];
+        if (base == NULL) {
+            printf("%-14s %-32s %21s\n", r[i].stage, r[i].dataset, "not in the baseline");
+            missing++;
+            continue;
+        }
+        mean_var(base->ns_per_byte, base->reps, 1.0, &mb, &vb);
+        mean_var(r[i].ns, r[i].reps, 1.0 / r[i].bytes_in, &mc, &vc);
+        /* Welch-Satterthwaite degrees of freedom */
+        se2 = vb / base->reps + vc / r[i].reps;
+        df = se2 > 0.0 ? se2 * se2 / (vb * vb / ((double)base->reps * base->reps * (base->reps - 1)) + vc * vc / ((double)r[i].reps * r[i].reps * (r[i].reps - 1))) : 1.0;
+        t = t_quantile_95(df);
+        diff = mc - mb;
+        lo = (diff - t * sqrt(se2)) / mb * 100.0;
+        hi = (diff + t * sqrt(se2)) / mb * 100.0;
+        medb = quantile(base->ns_per_byte, base->reps, 1.0, 0.5);
+        medc = quantile(r[i].ns, r[i].reps, 1.0 / r[i].bytes_in, 0.5);
+        median = (medc - medb) / medb * 100.0;
+        noise = fmax(spread(base->ns_per_byte, base->reps), spread(r[i].ns, r[i].reps));
+        regressed = lo > 0.0 && median > threshold && median > noise;
+        printf("%-14s %-32s %10.3f +- %7.3f %10.3f +- %7.3f %+7.1f%% [%+7.1f%%, %+7.1f%%] %+7.1f%% %5.1f%%%s\n", r[i].stage, r[i].dataset,
+            mb, t_quantile_95(base->reps - 1) * sqrt(vb / base->reps), mc, t_quantile_95(r[i].reps - 1) * sqrt(vc / r[i].reps),
+            diff / mb * 100.0, lo, hi, median, noise, regressed ? "  REGRESSION" : "");
+        if (regressed)
+            regressions++;
+    }
+    printf("%d of %d benchmarks regressed by more than %.1f%% and the noise", regressions, n - missing, threshold);
+    if (missing > 0)
+        printf(", %d not in the baseline", missing);
+    printf("\n");
+    return regressions;
+}
+
+/*
+ * Size sweep (bench --sweep): every stage, plus Ascon-128 and SipHash-2-4 frames, on one block
+ * of 16 bytes to 64 KiB, two sizes per octave. A buoy reading is 37 bytes and a firmware block
+ * about 400. Per stage, t(n) = fixed + n * per_byte is fitted with weights 1/t^2 (so every size
+ * counts the same in relative terms). The crossover n = fixed / per_byte is the block size at
+ * which half the time goes to the fixed cost, i.e. the throughput is half the asymptotic one.
+ */
+
+#define SWEEP_MIN 16
+#define SWEEP_MAX 65536
+#define SWEEP_SIZES 25        /* 16 * 2^(k / 2) for k = 0 .. 24 */
+#define SWEEP_BYTES (256 * 1024) /* processed per measurement, so small blocks run many times */
+#define SWEEP_DEFAULT_DATASET "../../../Testing/Simulation Data/Cleaned Data/Walking Around Example Data.csv"
+
+static size_t stage_ascon_seal(struct dataset* d)
+{
+    size_t off, blen, pos = 0;
+    uint64_t seqnr = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        d->sealed[pos] = blen & 0xff;
+        d->sealed[pos + 1] = (blen >> 8) & 0xff;
+        d->sealed[pos + 2] = (blen >> 16) & 0xff;
+        memcpy(d->sealed + pos + ASCON128_AAD_LEN, d->data + off, blen);
+        ascon128_crypt(&suite_ascon, seqnr++, d->sealed + pos, ASCON128_AAD_LEN + blen + ASCON128_TAGLEN,
+            d->sealed + pos, ASCON128_AAD_LEN + blen, 1);
+        pos += ASCON128_AAD_LEN + blen + ASCON128_TAGLEN;
+    }
+    return pos;
+}
+
+static size_t stage_siphash_seal(struct dataset* d)
+{
+    size_t off, blen, pos = 0;
+    uint64_t seqnr = 0;
+    FOR_EACH_BLOCK(d, off, blen) {
+        d->sealed[pos] = blen & 0xff;
+        d->sealed[pos + 1] = (blen >> 8) & 0xff;
+        d->sealed[pos + 2] = (blen >> 16) & 0xff;
+        memcpy(d->sealed + pos + SIPHASH_AAD_LEN, d->data + off, blen);
+        siphash24_mac_crypt(&suite_siphash, seqnr++, d->sealed + pos, SIPHASH_AAD_LEN + blen + SIPHASH_TAGLEN,
+            d->sealed + pos, SIPHASH_AAD_LEN + blen, 1);
+        pos += SIPHASH_AAD_LEN + blen + SIPHASH_TAGLEN;
+    }
+    return pos;
+}
+
+static const struct suite_stage sweep_stages[] = {
+    {"ascon_seal", stage_ascon_seal},
+    {"siphash_seal", stage_siphash_seal}};
+
+#define SWEEP_STAGES (SUITE_STAGES + sizeof(sweep_stages) / sizeof(sweep_stages[0]))
+
+static const struct suite_stage* sweep_stage(int i)
+{
+    return i < (int)SUITE_STAGES ? &suite_stages[i] : &sweep_stages[i - SUITE_STAGES];
+}
+
+/* the fastest of reps measurements, in ns per call on d->len bytes */
+static double sweep_time(const struct suite_stage* stage, struct dataset* d, int reps)
+{
+    long calls = SWEEP_BYTES / d->len, k;
+    double best = HUGE_VAL;
+    int i;
+
+    stage->run(d); /* warm up, and the input of the next stage */
+    for (i = 0; i < reps; i++) {
+        double begin = gettimens(), t;
+        for (k = 0; k < calls; k++)
+            stage->run(d);
+        t = (gettimens() - begin) / calls;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+static int run_sweep(const char* path, int reps)
+{
+    static double ns[SWEEP_STAGES][SWEEP_SIZES];
+    size_t sizes[SWEEP_SIZES];
+    struct dataset d;
+    int i, k;
+
+    suite_block = SWEEP_MAX; /* sizes the buffers for one block of up to SWEEP_MAX bytes */
+    if (load_dataset(&d, path, SWEEP_MAX) != 0 || d.len < SWEEP_MAX) {
+        fprintf(stderr, "? %s (needs %d bytes)\n", path, SWEEP_MAX);
+        return 1;
+    }
+    for (k = 0; k < SWEEP_SIZES; k++) {
+        sizes[k] = (size_t)(SWEEP_MIN * pow(2.0, k / 2.0) + 0.5);
+        d.len = suite_block = sizes[k];
+        fprintf(stderr, "%zu bytes\n", sizes[k]);
+        for (i = 0; i < (int)SWEEP_STAGES; i++)
+            ns[i][k] = sweep_time(sweep_stage(i), &d, reps);
+        if (memcmp(d.text, d.data, d.len) != 0) { /* written by pipeline_open */
+            fprintf(stderr, "%zu bytes: the pipeline does not round-trip\n", sizes[k]);
+            return 1;
+        }
+    }
+
+    printf("stage,bytes,ns_per_call,ns_per_byte,mb_per_s,fixed_ns,asymptotic_ns_per_byte,crossover_bytes\n");
+    fprintf(stderr, "%-14s %12s %14s %16s\n", "stage", "fixed ns", "ns/byte", "crossover bytes");
+    for (i = 0; i < (int)SWEEP_STAGES; i++) {
+        /* weighted least squares of t = fixed + n * per_byte */
+        double sw = 0, swn = 0, swnn = 0, swt = 0, swnt = 0, fixed, per_byte, crossover;
+        for (k = 0; k < SWEEP_SIZES; k++) {
+            double w = 1.0 / (ns[i][k] * ns[i][k]);
+            sw += w;
+            swn += w * sizes[k];
+            swnn += w * sizes[k] * sizes[k];
+            swt += w * ns[i][k];
+            swnt += w * sizes[k] * ns[i][k];
+        }
+        per_byte = (sw * swnt - swn * swt) / (sw * swnn - swn * swn);
+        fixed = (swt - per_byte * swn) / sw;
+        crossover = fixed > 0 && per_byte > 0 ? fixed / per_byte : 0; /* 0: no measurable fixed cost */
+        fprintf(stderr, "%-14s %12.1f %14.3f %16.0f\n", sweep_stage(i)->name, fixed, per_byte, crossover);
+        for (k = 0; k < SWEEP_SIZES; k++)
+            printf("%s,%zu,%.1f,%.3f,%.2f,%.1f,%.3f,%.0f\n", sweep_stage(i)->name, sizes[k], ns[i][k],
+                ns[i][k] / sizes[k], sizes[k] * 1000.0 / ns[i][k], fixed, per_byte, crossover);
+    }
+    free_dataset(&d);
     return 0;
-}
\ No newline at end of file
+}
+
+/*
+ * Instruction counting (bench --run-stages n dataset): loads the dataset and runs the first n
+ * stages of the sweep list once each, without timing. m0_icount.sh runs this for n = 0, 1, ...
+ * under an instruction-counting emulator, so stage n costs the difference between runs n and
+ * n - 1. Prints the name of stage n ("load" for 0) and the bytes it processed.
+ */
+static int run_stages(const char* path, int n, size_t max_bytes)
+{
+    struct dataset d;
+    int i;
+
+    if (load_dataset(&d, path, max_bytes) != 0) {
+        fprintf(stderr, "? %s\n", path);
+        return 1;
+    }
+    for (i = 0; i < n; i++)
+        sweep_stage(i)->run(&d);
+    printf("%s %zu\n", n > 0 ? sweep_stage(n - 1)->name : "load", d.len);
+    free_dataset(&d);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+        "Usage: bench                    primitive benchmarks\n"
+        "       bench --csv|--json [options] [dataset ...]\n"
+        "                                every pipeline stage over the datasets (default: Testing/)\n"
+        "       bench --save-baseline file [options] [dataset ...]\n"
+        "       bench --compare file [--threshold percent] [options] [dataset ...]\n"
+        "                                exits with %d if a stage is slower than the baseline at 95%% confidence\n"
+        "                                and its median by more than the threshold (default %.0f%%) and the\n"
+        "                                spread of the runs\n"
+        "       bench --sweep [--reps n] [dataset]\n"
+        "                                every stage on one block of 16 bytes to 64 KiB, CSV\n"
+        "       bench --run-stages n [--block bytes] [--max-bytes bytes] dataset\n"
+        "                                runs the first n stages once, for m0_icount.sh\n"
+        "Options: --reps n (default %d, %d for baselines, at least 2) --block bytes --max-bytes bytes\n"
+        "         --perf  adds IPC and misses per byte from the hardware counters (Linux) to --csv and --json\n",
+        EXIT_REGRESSION, DEFAULT_THRESHOLD, SUITE_DEFAULT_REPS, BASELINE_DEFAULT_REPS);
+    exit(1);
+}
+
+enum suite_output { OUTPUT_CSV, OUTPUT_JSON, OUTPUT_SAVE_BASELINE, OUTPUT_COMPARE, OUTPUT_SWEEP, OUTPUT_RUN_STAGES };
+
+int main(int argc, char* argv[])
+{
+    int output = -1, reps = 0, reps_set = 0, ndatasets, n = 0, nbaseline = 0, nstages = 0, ret = 0, i;
+    size_t max_bytes = SUITE_DEFAULT_MAX_BYTES, baseline_block;
+    double threshold = DEFAULT_THRESHOLD;
+    const char** datasets = default_datasets;
+    const char* baseline_path = NULL;
+    struct suite_result* results;
+    struct baseline* baseline = NULL;
+
+    if (argc == 1) {
+        run_micro_benchmarks();
+        return 0;
+    }
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "--csv") == 0) output = OUTPUT_CSV;
+        else if (strcmp(argv[i], "--json") == 0) output = OUTPUT_JSON;
+        else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc) output = OUTPUT_SAVE_BASELINE, baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) output = OUTPUT_COMPARE, baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--sweep") == 0) output = OUTPUT_SWEEP;
+        else if (strcmp(argv[i], "--run-stages") == 0 && i + 1 < argc) output = OUTPUT_RUN_STAGES, nstages = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--perf") == 0) suite_perf = 1;
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]), reps_set = 1;
+        else if (strcmp(argv[i], "--block") == 0 && i + 1 < argc) suite_block = atol(argv[++i]);
+        else if (strcmp(argv[i], "--max-bytes") == 0 && i + 1 < argc) max_bytes = atol(argv[++i]);
+        else usage();
+    }
+    if (!reps_set)
+        reps = output == OUTPUT_SAVE_BASELINE || output == OUTPUT_COMPARE ? BASELINE_DEFAULT_REPS : SUITE_DEFAULT_REPS;
+    if (output < 0 || reps < 1 || reps > SUITE_MAX_REPS || suite_block < 1 || suite_block > (1 << 20) || max_bytes < 1 ||
+        ((output == OUTPUT_SAVE_BASELINE || output == OUTPUT_COMPARE) && reps < 2) ||
+        (output == OUTPUT_RUN_STAGES && (nstages < 0 || nstages > (int)SWEEP_STAGES || i + 1 != argc)))
+        usage();
+    if (i < argc) {
+        datasets = (const char**)argv + i;
+        ndatasets = argc - i;
+    } else {
+        ndatasets = sizeof(default_datasets) / sizeof(default_datasets[0]);
+    }
+    if (output == OUTPUT_COMPARE) {
+        baseline = malloc(ndatasets * SUITE_STAGES * sizeof(*baseline));
+        if (baseline == NULL || (nbaseline = load_baseline(baseline_path, baseline, ndatasets * SUITE_STAGES, &baseline_block)) < 0) {
+            fprintf(stderr, "? %s\n", baseline_path);
+            return 1;
+        }
+        if (baseline_block != suite_block)
+            fprintf(stderr, "warning: the baseline was taken with --block %zu\n", baseline_block);
+    }
+
+    chacha_keysetup(&suite_chacha, testkey, 256);
+    chacha20poly1305_init(&suite_aead, aead_keys, 32, aead_keys + 32, 32);
+    ascon128_init(&suite_ascon, aead_keys, ASCON128_KEY_LEN);
+    siphash24_mac_init(&suite_siphash, aead_keys, SIPHASH_KEY_LEN);
+    if (suite_perf && perf_open() == 0)
+        fprintf(stderr, "warning: no hardware counters, --perf adds empty columns\n");
+    if (output == OUTPUT_RUN_STAGES)
+        return run_stages(datasets[0], nstages, max_bytes);
+    if (output == OUTPUT_SWEEP)
+        return run_sweep(datasets == default_datasets ? SWEEP_DEFAULT_DATASET : datasets[0], reps);
+    results = calloc(ndatasets * SUITE_STAGES, sizeof(*results));
+    if (results == NULL)
+        return 1;
+    for (i = 0; i < ndatasets; i++) {
+        struct dataset d;
+        if (load_dataset(&d, datasets[i], max_bytes) != 0) {
+            fprintf(stderr, "? %s\n", datasets[i]);
+            return 1;
+        }
+        fprintf(stderr, "%s: %zu bytes\n", d.name, d.len);
+        run_stages_timed(suite_stages, SUITE_STAGES, &d, reps, &results[n]);
+        n += SUITE_STAGES;
+        if (memcmp(d.text, d.data, d.len) != 0) { /* pipeline_open is the last decoder */
+            fprintf(stderr, "%s: the pipeline does not round-trip\n", d.name);
+            return 1;
+        }
+        free_dataset(&d); /* the results keep pointers into argv / default_datasets only */
+    }
+    switch (output) {
+    case OUTPUT_CSV:
+        print_csv(results, n);
+        break;
+    case OUTPUT_JSON:
+        print_json(results, n);
+        break;
+    case OUTPUT_SAVE_BASELINE:
+        if (save_baseline(baseline_path, results, n) != 0) {
+            fprintf(stderr, "? %s\n", baseline_path);
+            ret = 1;
+        }
+        break;
+    case OUTPUT_COMPARE:
+        if (compare_baseline(baseline, nbaseline, results, n, threshold) > 0)
+            ret = EXIT_REGRESSION;
+        break;
+    }
+    free(baseline);
+    free(results);
+    return ret;
+}
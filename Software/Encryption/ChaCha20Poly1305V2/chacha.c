@@ -54,6 +54,7 @@ static const char tau[16] = "expand 16-byte k";
 void chacha_keysetup(chacha_ctx *x, const u8 *k, u32 kbits) {
   const char *constants;
 
+  x->rounds = CHACHA_ROUNDS;
   x->input[4] = U8TO32_LITTLE(k + 0);
   x->input[5] = U8TO32_LITTLE(k + 4);
   x->input[6] = U8TO32_LITTLE(k + 8);
@@ -74,6 +75,8 @@ void chacha_keysetup(chacha_ctx *x, const u8 *k, u32 kbits) {
   x->input[3] = U8TO32_LITTLE(constants + 12);
 }
 
+void chacha_roundsetup(chacha_ctx *x, u32 rounds) { x->rounds = rounds; }
+
 void chacha_ivsetup(chacha_ctx *x, const u8 *iv, const u8 *counter) {
   x->input[12] = counter == NULL ? 0 : U8TO32_LITTLE(counter + 0);
   x->input[13] = counter == NULL ? 0 : U8TO32_LITTLE(counter + 4);
@@ -135,7 +138,7 @@ void chacha_encrypt_bytes(chacha_ctx *x, const u8 *m, u8 *c, u32 bytes) {
     x13 = j13;
     x14 = j14;
     x15 = j15;
-    for (i = 20; i > 0; i -= 2) {
+    for (i = x->rounds; i >= 2; i -= 2) {
       QUARTERROUND(x0, x4, x8, x12)
       QUARTERROUND(x1, x5, x9, x13)
       QUARTERROUND(x2, x6, x10, x14)
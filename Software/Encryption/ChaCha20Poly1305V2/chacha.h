@@ -12,8 +12,14 @@ Public domain.
 #include <stdint.h>
 #include <stdlib.h>
 
+/* rounds per block (run as double rounds): 20 is standard ChaCha, 12 and 8 are the reduced-round profiles */
+#ifndef CHACHA_ROUNDS
+#define CHACHA_ROUNDS 20
+#endif
+
 struct chacha_ctx {
   uint32_t input[16];
+  uint32_t rounds;
 };
 
 #define CHACHA_MINKEYLEN 16
@@ -24,6 +30,7 @@ struct chacha_ctx {
 
 void chacha_keysetup(struct chacha_ctx *x, const uint8_t *k, uint32_t kbits)
     __attribute__((__bounded__(__minbytes__, 2, CHACHA_MINKEYLEN)));
+void chacha_roundsetup(struct chacha_ctx *x, uint32_t rounds);
 void chacha_ivsetup(struct chacha_ctx *x, const uint8_t *iv, const uint8_t *ctr)
     __attribute__((__bounded__(__minbytes__, 2, CHACHA_NONCELEN)))
     __attribute__((__bounded__(__minbytes__, 3, CHACHA_CTRLEN)));
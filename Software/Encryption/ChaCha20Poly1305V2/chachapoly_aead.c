@@ -53,6 +53,16 @@
 #else
 #error byte order not supported
 #endif /* endif byteorder */
+
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+/* bare-metal little-endian targets (e.g. the STM32F0 firmware) */
+#define htole32(x) (x)
+#define le32toh(x) (x)
+
+#define htole64(x) (x)
+#define le64toh(x) (x)
+
 #else
 
 #error platform not supported
@@ -99,14 +109,27 @@ int chacha20poly1305_init(struct chachapolyaead_ctx* ctx, const uint8_t* k_1, in
     return 0;
 }
 
+/* switches both keystreams to ChaCha8, ChaCha12 or ChaCha20 (the default is CHACHA_ROUNDS) */
+int chacha20poly1305_set_rounds(struct chachapolyaead_ctx* ctx, int rounds)
+{
+    if (!CHACHA20_POLY1305_ROUNDS_OK(rounds))
+        return -1;
+    chacha_roundsetup(&ctx->main_ctx, rounds);
+    chacha_roundsetup(&ctx->header_ctx, rounds);
+    ctx->cached_aad_seqnr = UINT64_MAX; /* the cached length keystream was made with the old rounds */
+    return 0;
+}
+
 int chacha20poly1305_crypt(struct chachapolyaead_ctx* ctx, uint64_t seqnr, uint64_t seqnr_aad, int pos_aad, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t src_len, int is_encrypt)
 {
     const uint8_t one[8] = {1, 0, 0, 0, 0, 0, 0, 0}; /* NB little-endian */
     uint64_t aad_chacha_nonce_hdr = 0;
     uint8_t expected_tag[POLY1305_TAGLEN], poly_key[POLY1305_KEYLEN];
     int r = -1;
-    int aad_pos = 0;
 
+    if (pos_aad < 0 || pos_aad > CHACHA20_ROUND_OUTPUT - CHACHA20_POLY1305_AEAD_AAD_LEN) {
+        return r;
+    }
     if (
         // if we encrypt, make sure the source contains at least the expected AAD and the destination has at least space for the source + MAC
         (is_encrypt && (src_len < CHACHA20_POLY1305_AEAD_AAD_LEN || dest_len < src_len + POLY1305_TAGLEN)) ||
@@ -139,9 +162,9 @@ int chacha20poly1305_crypt(struct chachapolyaead_ctx* ctx, uint64_t seqnr, uint6
         chacha_encrypt_bytes(&ctx->header_ctx, NULL, ctx->aad_keystream_buffer, CHACHA20_ROUND_OUTPUT);
     }
     /* crypt the AAD (3 byte length) */
-    dest[0] = XOR(src[0], ctx->aad_keystream_buffer[aad_pos + 0]);
-    dest[1] = XOR(src[1], ctx->aad_keystream_buffer[aad_pos + 1]);
-    dest[2] = XOR(src[2], ctx->aad_keystream_buffer[aad_pos + 2]);
+    dest[0] = XOR(src[0], ctx->aad_keystream_buffer[pos_aad + 0]);
+    dest[1] = XOR(src[1], ctx->aad_keystream_buffer[pos_aad + 1]);
+    dest[2] = XOR(src[2], ctx->aad_keystream_buffer[pos_aad + 2]);
 
     /* Set Chacha's block counter to 1 and encipher */
     chacha_ivsetup(&ctx->main_ctx, (uint8_t*)&chacha_iv, one);
@@ -164,10 +187,8 @@ int chacha20poly1305_get_length(struct chachapolyaead_ctx* ctx,
     uint64_t seqnr,
     const uint8_t* ciphertext)
 {
-    uint8_t buf[3], seqbuf[8];
-
     int pos = seqnr % AAD_PACKAGES_PER_ROUND * CHACHA20_POLY1305_AEAD_AAD_LEN;
-    seqnr = seqnr / (float)AAD_PACKAGES_PER_ROUND; /* 21 x 3byte length packages fits in a ChaCha20 round */
+    seqnr = seqnr / AAD_PACKAGES_PER_ROUND; /* 21 x 3byte length packages fits in a ChaCha20 round */
     if (ctx->cached_aad_seqnr != seqnr) {
         /* we need to calculate the 64 keystream bytes since we reached a new sequence number */
         ctx->cached_aad_seqnr = seqnr;
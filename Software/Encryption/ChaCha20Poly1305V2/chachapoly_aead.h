@@ -8,6 +8,7 @@
 #define CHACHA20_POLY1305_AEAD_AAD_LEN 3 /* 3 bytes length */
 #define CHACHA20_ROUND_OUTPUT 64         /* 64 bytes per round */
 #define AAD_PACKAGES_PER_ROUND 21        /* 64 / 3 round down*/
+#define CHACHA20_POLY1305_ROUNDS_OK(r) ((r) == 8 || (r) == 12 || (r) == 20) /* ChaCha8/12/20 */
 
 struct chachapolyaead_ctx {
     struct chacha_ctx main_ctx, header_ctx;
@@ -16,6 +17,7 @@ struct chachapolyaead_ctx {
 };
 
 int chacha20poly1305_init(struct chachapolyaead_ctx* cpctx, const uint8_t* k_1, int k_1_len, const uint8_t* k_2, int k_2_len);
+int chacha20poly1305_set_rounds(struct chachapolyaead_ctx* ctx, int rounds);
 int chacha20poly1305_crypt(struct chachapolyaead_ctx* ctx, uint64_t seqnr, uint64_t seqnr_aad, int pos_aad, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t srv_len, int is_encrypt);
 int chacha20poly1305_get_length(struct chachapolyaead_ctx* ctx,
     uint32_t* len_out,
@@ -0,0 +1,135 @@
+/* LZSS encoder-decoder (Haruhiko Okumura; public domain), reading and writing memory blocks */
+
+#include "lzss_block.h"
+
+#define EI LZSS_EI
+#define EJ LZSS_EJ
+#define P   1  /* If match length <= P then output one character */
+#define N (1 << EI)  /* buffer size */
+#define F ((1 << EJ) + 1)  /* lookahead buffer size */
+
+struct bitwriter {
+    uint8_t* out;
+    int outmax;
+    int codecount;
+    int bit_buffer, bit_mask;
+};
+
+static void putbit(struct bitwriter* w, int bit)
+{
+    if (bit) w->bit_buffer |= w->bit_mask;
+    if ((w->bit_mask >>= 1) == 0) {
+        if (w->codecount < w->outmax) w->out[w->codecount] = w->bit_buffer;
+        w->codecount++;
+        w->bit_buffer = 0;  w->bit_mask = 128;
+    }
+}
+
+static void flush_bit_buffer(struct bitwriter* w)
+{
+    if (w->bit_mask != 128) {
+        if (w->codecount < w->outmax) w->out[w->codecount] = w->bit_buffer;
+        w->codecount++;
+    }
+}
+
+static void output1(struct bitwriter* w, int c)
+{
+    int mask;
+
+    putbit(w, 1);
+    mask = 256;
+    while (mask >>= 1) putbit(w, c & mask);
+}
+
+static void output2(struct bitwriter* w, int x, int y)
+{
+    int mask;
+
+    putbit(w, 0);
+    mask = N;
+    while (mask >>= 1) putbit(w, x & mask);
+    mask = (1 << EJ);
+    while (mask >>= 1) putbit(w, y & mask);
+}
+
+int lzss_encode(const uint8_t* in, int inlen, uint8_t* out, int outmax)
+{
+    int i, j, f1, x, y, r, s, bufferend, c;
+    int textcount = 0;
+    uint8_t buffer[N * 2];
+    struct bitwriter w = {out, outmax, 0, 0, 128};
+
+    for (i = 0; i < N - F; i++) buffer[i] = ' ';
+    for (i = N - F; i < N * 2; i++) {
+        if (textcount >= inlen) break;
+        buffer[i] = in[textcount++];
+    }
+    bufferend = i;  r = N - F;  s = 0;
+    while (r < bufferend) {
+        f1 = (F <= bufferend - r) ? F : bufferend - r;
+        x = 0;  y = 1;  c = buffer[r];
+        for (i = r - 1; i >= s; i--)
+            if (buffer[i] == c) {
+                for (j = 1; j < f1; j++)
+                    if (buffer[i + j] != buffer[r + j]) break;
+                if (j > y) {
+                    x = i;  y = j;
+                }
+            }
+        if (y <= P) {  y = 1;  output1(&w, c);  }
+        else output2(&w, x & (N - 1), y - 2);
+        r += y;  s += y;
+        if (r >= N * 2 - F) {
+            for (i = 0; i < N; i++) buffer[i] = buffer[i + N];
+            bufferend -= N;  r -= N;  s -= N;
+            while (bufferend < N * 2) {
+                if (textcount >= inlen) break;
+                buffer[bufferend++] = in[textcount++];
+            }
+        }
+    }
+    flush_bit_buffer(&w);
+    return w.codecount <= outmax ? w.codecount : -1;
+}
+
+int lzss_decode(const uint8_t* in, int inlen, uint8_t* out, int outmax)
+{
+    int i, j, k, r, c, n;
+    int pos = 0, textcount = 0;
+    uint8_t buffer[N];
+
+    /* get n bits, -1 at the end of the block */
+#define GETBITS(x, n)                                   \
+    do {                                                \
+        (x) = 0;                                        \
+        for (k = 0; k < (n); k++, pos++) {              \
+            if (pos >= inlen * 8) goto done;            \
+            (x) = ((x) << 1) | ((in[pos >> 3] >> (7 - (pos & 7))) & 1); \
+        }                                               \
+    } while (0)
+
+    for (i = 0; i < N - F; i++) buffer[i] = ' ';
+    r = N - F;
+    for (;;) {
+        GETBITS(c, 1);
+        if (c) {
+            GETBITS(c, 8);
+            if (textcount >= outmax) return -1;
+            out[textcount++] = c;
+            buffer[r++] = c;  r &= (N - 1);
+        } else {
+            GETBITS(i, EI);
+            GETBITS(j, EJ);
+            for (n = 0; n <= j + 1; n++) {
+                c = buffer[(i + n) & (N - 1)];
+                if (textcount >= outmax) return -1;
+                out[textcount++] = c;
+                buffer[r++] = c;  r &= (N - 1);
+            }
+        }
+    }
+#undef GETBITS
+done:
+    return textcount;
+}
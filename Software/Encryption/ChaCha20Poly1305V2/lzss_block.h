@@ -0,0 +1,26 @@
+/*
+ * Block (memory to memory) version of the LZSS encoder-decoder
+ * (Haruhiko Okumura; public domain). Every block is coded independently,
+ * so a block can be decoded without the blocks before it.
+ */
+
+#ifndef LZSS_BLOCK_H
+#define LZSS_BLOCK_H
+
+#include <stdint.h>
+
+#ifndef LZSS_EI
+#define LZSS_EI 11 /* typically 10..13 */
+#endif
+#ifndef LZSS_EJ
+#define LZSS_EJ 4  /* typically 4..5 */
+#endif
+
+/* worst case: every byte is a 9 bit literal */
+#define LZSS_MAX_ENCODED(n) ((n) + ((n) + 7) / 8)
+
+/* both return the number of bytes written to out, or -1 if out is too small */
+int lzss_encode(const uint8_t* in, int inlen, uint8_t* out, int outmax);
+int lzss_decode(const uint8_t* in, int inlen, uint8_t* out, int outmax);
+
+#endif /* LZSS_BLOCK_H */
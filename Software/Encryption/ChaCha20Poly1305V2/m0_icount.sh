@@ -0,0 +1,43 @@
+#!/bin/sh
+# Instructions per byte of every bench stage on a Cortex-M0 (thumbv6m) build, counted by
+# qemu-arm with the insn plugin. bench-m0 is a bare-metal newlib program that does its I/O by
+# semihosting, which qemu-arm serves; -cpu cortex-m0 makes qemu decode ARMv6-M only, so an
+# instruction the M0 does not have stops the run instead of being counted.
+# bench --run-stages n runs the first n stages once, so a stage costs the difference between
+# two runs.
+#
+# Usage: m0_icount.sh bench-m0 libinsn.so dataset [max bytes]   (QEMU_ARM overrides qemu-arm)
+
+if [ $# -lt 3 ]; then
+    echo "Usage: $0 bench-m0 libinsn.so dataset [max bytes]" >&2
+    exit 1
+fi
+BENCH=$1
+PLUGIN=$2
+DATASET=$3
+MAX_BYTES=${4:-16384}
+QEMU_ARM=${QEMU_ARM:-qemu-arm}
+LOG=$(mktemp)
+trap 'rm -f "$LOG"' EXIT
+
+echo "stage,bytes,instructions,instructions_per_byte"
+n=0
+prev=
+# bench rejects n past the last stage, which ends the loop
+while out=$("$QEMU_ARM" -cpu cortex-m0 -plugin "$PLUGIN" -d plugin -D "$LOG" "$BENCH" --run-stages $n --max-bytes "$MAX_BYTES" "$DATASET" 2>/dev/null); do
+    # the plugin ends with "total insns: N" (older versions: "insns: N")
+    insns=$(sed -n 's/.*insns: *\([0-9][0-9]*\).*/\1/p' "$LOG" | tail -n 1)
+    if [ -z "$insns" ]; then
+        echo "no instruction count in the log of $QEMU_ARM -plugin $PLUGIN" >&2
+        exit 1
+    fi
+    if [ -n "$prev" ]; then
+        echo "$out $insns $prev" | awk '{ printf "%s,%d,%d,%.2f\n", $1, $2, $3 - $4, ($3 - $4) / $2 }'
+    fi
+    prev=$insns
+    n=$((n + 1))
+done
+if [ -z "$prev" ]; then
+    echo "$QEMU_ARM -cpu cortex-m0 $BENCH --run-stages 0 failed" >&2
+    exit 1
+fi
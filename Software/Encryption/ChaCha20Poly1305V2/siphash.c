@@ -0,0 +1,114 @@
+/*
+ * SipHash-2-4 (Jean-Philippe Aumasson, Daniel J. Bernstein), after the reference implementation.
+ * 64-bit additions, rotations and XORs only; one compression per 8 bytes.
+ */
+
+#include "siphash.h"
+
+#include <string.h>
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND                                                   \
+    do {                                                           \
+        v0 += v1;  v1 = ROTL64(v1, 13);  v1 ^= v0;  v0 = ROTL64(v0, 32); \
+        v2 += v3;  v3 = ROTL64(v3, 16);  v3 ^= v2;                 \
+        v0 += v3;  v3 = ROTL64(v3, 21);  v3 ^= v0;                 \
+        v2 += v1;  v1 = ROTL64(v1, 17);  v1 ^= v2;  v2 = ROTL64(v2, 32); \
+    } while (0)
+
+static uint64_t load64_le(const uint8_t* p, size_t n)
+{
+    uint64_t x = 0;
+    size_t i;
+    for (i = 0; i < n; i++)
+        x |= (uint64_t)p[i] << (8 * i);
+    return x;
+}
+
+static void store64_le(uint8_t* p, uint64_t x)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+        p[i] = (uint8_t)(x >> (8 * i));
+}
+
+/* SipHash-2-4 of (prefix as 8 little-endian bytes, if not NULL) || in */
+static uint64_t siphash_core(uint64_t k0, uint64_t k1, const uint64_t* prefix, const uint8_t* in, size_t inlen)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ k1;
+    uint64_t m, b = (uint64_t)(inlen + (prefix != NULL ? 8 : 0)) << 56;
+
+    if (prefix != NULL) {
+        v3 ^= *prefix;  SIPROUND;  SIPROUND;  v0 ^= *prefix;
+    }
+    for (; inlen >= 8; in += 8, inlen -= 8) {
+        m = load64_le(in, 8);
+        v3 ^= m;  SIPROUND;  SIPROUND;  v0 ^= m;
+    }
+    b |= load64_le(in, inlen);
+    v3 ^= b;  SIPROUND;  SIPROUND;  v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND;  SIPROUND;  SIPROUND;  SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+void siphash24(uint8_t out[SIPHASH_TAGLEN], const uint8_t* in, size_t inlen, const uint8_t key[SIPHASH_KEY_LEN])
+{
+    store64_le(out, siphash_core(load64_le(key, 8), load64_le(key + 8, 8), NULL, in, inlen));
+}
+
+int siphash24_mac_init(struct siphash_ctx* ctx, const uint8_t* k, int k_len)
+{
+    if (k_len != SIPHASH_KEY_LEN)
+        return -1;
+    ctx->k0 = load64_le(k, 8);
+    ctx->k1 = load64_le(k + 8, 8);
+    return 0;
+}
+
+int siphash24_mac_crypt(struct siphash_ctx* ctx, uint64_t seqnr, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t src_len, int is_encrypt)
+{
+    uint8_t tag[SIPHASH_TAGLEN];
+    int i, r = 0;
+
+    if (
+        // if we seal, make sure the source contains at least the length and the destination has space for the source + tag
+        (is_encrypt && (src_len < SIPHASH_AAD_LEN || dest_len < src_len + SIPHASH_TAGLEN)) ||
+        // if we open, make sure the source contains at least the length + tag and the destination has space for the source - tag
+        (!is_encrypt && (src_len < SIPHASH_AAD_LEN + SIPHASH_TAGLEN || dest_len < src_len - SIPHASH_TAGLEN))) {
+        return -1;
+    }
+    if (!is_encrypt)
+        src_len -= SIPHASH_TAGLEN;
+
+    /* the sequence number is authenticated but not sent, so replayed or reordered frames fail */
+    store64_le(tag, siphash_core(ctx->k0, ctx->k1, &seqnr, src, src_len));
+    if (!is_encrypt) {
+        for (i = 0; i < SIPHASH_TAGLEN; i++)
+            r |= tag[i] ^ src[src_len + i];
+        if (r != 0)
+            return -1;
+    }
+    if (dest != src)
+        memmove(dest, src, src_len);
+    if (is_encrypt)
+        memcpy(dest + src_len, tag, SIPHASH_TAGLEN);
+    return 0;
+}
+
+int siphash24_mac_get_length(struct siphash_ctx* ctx,
+    uint32_t* len_out,
+    uint64_t seqnr,
+    const uint8_t* frame)
+{
+    (void)ctx;
+    (void)seqnr;
+    /* the length is sent in the clear */
+    *len_out = frame[0] | frame[1] << 8 | (uint32_t)frame[2] << 16;
+    return 0;
+}
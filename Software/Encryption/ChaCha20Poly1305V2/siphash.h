@@ -0,0 +1,31 @@
+#ifndef SIPHASH_H
+#define SIPHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * SipHash-2-4 (Aumasson, Bernstein) and an authentication-only frame built on it.
+ * The frame has the layout of chachapoly_aead.h, but nothing is encrypted:
+ * [3 byte length][data][8 byte tag], the tag covering the sequence number, the length and the data.
+ * Use it when the data may be public but has to be tamper-evident.
+ */
+
+#define SIPHASH_KEY_LEN 16
+#define SIPHASH_TAGLEN 8
+#define SIPHASH_AAD_LEN 3          /* 3 bytes length */
+#define SIPHASH_FRAME_SUITE 0x81   /* frame header byte, next to ASCON128_FRAME_SUITE */
+
+struct siphash_ctx {
+    uint64_t k0, k1;
+};
+
+void siphash24(uint8_t out[SIPHASH_TAGLEN], const uint8_t* in, size_t inlen, const uint8_t key[SIPHASH_KEY_LEN]);
+
+int siphash24_mac_init(struct siphash_ctx* ctx, const uint8_t* k, int k_len);
+int siphash24_mac_crypt(struct siphash_ctx* ctx, uint64_t seqnr, uint8_t* dest, size_t dest_len, const uint8_t* src, size_t src_len, int is_encrypt);
+int siphash24_mac_get_length(struct siphash_ctx* ctx,
+    uint32_t* len_out,
+    uint64_t seqnr,
+    const uint8_t* frame);
+#endif /* SIPHASH_H */
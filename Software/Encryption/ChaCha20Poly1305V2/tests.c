@@ -10,8 +10,11 @@
 #include <string.h>
 
 #include "chacha.h"
+#include "ascon_aead.h"
 #include "chachapoly_aead.h"
+#include "lzss_block.h"
 #include "poly1305.h"
+#include "siphash.h"
 
 struct chacha20_testvector {
     uint8_t key[32];
@@ -144,6 +147,27 @@ int main(void)
                    chacha20_testvectors[i].keystream_check_size) == 0);
     }
 
+    /* test the reduced-round profiles (zero key and nonce, draft-strombergson-chacha-test-vectors TC1) */
+    {
+        static const uint8_t chacha8_zero[32] = {
+            0x3e, 0x00, 0xef, 0x2f, 0x89, 0x5f, 0x40, 0xd6, 0x7f, 0x5b, 0xb8,
+            0xe8, 0x1f, 0x09, 0xa5, 0xa1, 0x2c, 0x84, 0x0e, 0xc3, 0xce, 0x9a,
+            0x7f, 0x3b, 0x18, 0x1b, 0xe1, 0x88, 0xef, 0x71, 0x1a, 0x1e};
+        static const uint8_t chacha12_zero[32] = {
+            0x9b, 0xf4, 0x9a, 0x6a, 0x07, 0x55, 0xf9, 0x53, 0x81, 0x1f, 0xce,
+            0x12, 0x5f, 0x26, 0x83, 0xd5, 0x04, 0x29, 0xc3, 0xbb, 0x49, 0xe0,
+            0x74, 0x14, 0x7e, 0x00, 0x89, 0xa5, 0x2e, 0xae, 0x15, 0x5f};
+
+        chacha_keysetup(&ctx, chacha20_testvectors[0].key, 256);
+        chacha_roundsetup(&ctx, 8);
+        chacha_ivsetup(&ctx, chacha20_testvectors[0].nonce, NULL);
+        chacha_encrypt_bytes(&ctx, NULL, keystream, 64);
+        assert(memcmp(keystream, chacha8_zero, 32) == 0);
+        chacha_roundsetup(&ctx, 12);
+        chacha_ivsetup(&ctx, chacha20_testvectors[0].nonce, NULL);
+        chacha_encrypt_bytes(&ctx, NULL, keystream, 64);
+        assert(memcmp(keystream, chacha12_zero, 32) == 0);
+    }
 
     /* test poly1305 */
     for (i = 0;
@@ -208,4 +232,113 @@ int main(void)
         sizeof(ciphertext_buf), 0);
     assert(memcmp(plaintext_buf, plaintext_buf_new, 252) == 0);
 
+    /* the length has to be found at the same AAD position that crypt used, also past the first AAD round */
+    for (seqnr = 0; seqnr < 2 * AAD_PACKAGES_PER_ROUND + 2; seqnr++) {
+        chacha20poly1305_crypt(&aead_ctx, seqnr, seqnr / AAD_PACKAGES_PER_ROUND,
+            (seqnr % AAD_PACKAGES_PER_ROUND) * CHACHA20_POLY1305_AEAD_AAD_LEN, ciphertext_buf, 300, plaintext_buf, 255, 1);
+        chacha20poly1305_get_length(&aead_ctx, &out_len, seqnr, ciphertext_buf);
+        assert(out_len == 255);
+    }
+    assert(chacha20poly1305_crypt(&aead_ctx, 0, 0, CHACHA20_ROUND_OUTPUT - 2, ciphertext_buf, 300, plaintext_buf, 255, 1) != 0);
+
+    /* a frame only opens with the rounds it was sealed with */
+    assert(chacha20poly1305_set_rounds(&aead_ctx, 10) != 0);
+    assert(chacha20poly1305_set_rounds(&aead_ctx, 8) == 0);
+    assert(chacha20poly1305_crypt(&aead_ctx, 0, 0, 0, ciphertext_buf, 300, plaintext_buf, 255, 1) == 0);
+    assert(chacha20poly1305_crypt(&aead_ctx, 0, 0, 0, plaintext_buf_new, 255, ciphertext_buf, sizeof(ciphertext_buf), 0) == 0);
+    assert(memcmp(plaintext_buf + 3, plaintext_buf_new + 3, 252) == 0);
+    assert(chacha20poly1305_set_rounds(&aead_ctx, 20) == 0);
+    assert(chacha20poly1305_crypt(&aead_ctx, 0, 0, 0, plaintext_buf_new, 255, ciphertext_buf, sizeof(ciphertext_buf), 0) != 0);
+
+    /* test Ascon-128 (LWC_AEAD_KAT_128_128.txt, key = nonce = 00 01 .. 0f, AD and PT = 00 01 ..) */
+    {
+        static const uint8_t ascon_kat_empty[16] = {
+            0xe3, 0x55, 0x15, 0x9f, 0x29, 0x29, 0x11, 0xf7,
+            0x94, 0xcb, 0x14, 0x32, 0xa0, 0x10, 0x3a, 0x8a}; /* Count = 1 */
+        static const uint8_t ascon_kat_ad1[16] = {
+            0x94, 0x4d, 0xf8, 0x87, 0xcd, 0x49, 0x01, 0x61,
+            0x4c, 0x5d, 0xed, 0xbc, 0x42, 0xfc, 0x0d, 0xa0}; /* Count = 2 */
+        static const uint8_t ascon_kat_pt1[17] = {
+            0xbc, 0x18, 0xc3, 0xf4, 0xe3, 0x9e, 0xca, 0x72, 0x22,
+            0x49, 0x0d, 0x96, 0x7c, 0x79, 0xbf, 0xfc, 0x92}; /* Count = 34 */
+        uint8_t ascon_key[16], ascon_nonce[16], ascon_in[16], ascon_out[32];
+        struct asconaead_ctx ascon_ctx;
+
+        for (i = 0; i < 16; i++) {
+            ascon_key[i] = ascon_nonce[i] = ascon_in[i] = i;
+        }
+        assert(ascon128_aead(ascon_key, ascon_nonce, ascon_in, 0, ascon_out, ascon_in, 0, 1) == 0);
+        assert(memcmp(ascon_out, ascon_kat_empty, 16) == 0);
+        assert(ascon128_aead(ascon_key, ascon_nonce, ascon_in, 1, ascon_out, ascon_in, 0, 1) == 0);
+        assert(memcmp(ascon_out, ascon_kat_ad1, 16) == 0);
+        assert(ascon128_aead(ascon_key, ascon_nonce, ascon_in, 0, ascon_out, ascon_in, 1, 1) == 0);
+        assert(memcmp(ascon_out, ascon_kat_pt1, 17) == 0);
+        assert(ascon128_aead(ascon_key, ascon_nonce, ascon_in, 0, ascon_out, ascon_kat_pt1, 17, 0) == 0);
+        assert(ascon_out[0] == 0x00);
+        ascon_out[0] = 0xbc;
+        ascon_out[16] ^= 1;
+        assert(ascon128_aead(ascon_key, ascon_nonce, ascon_in, 0, ascon_out + 17, ascon_out, 17, 0) != 0);
+
+        /* frames: the same layout and length lookup as the ChaCha20-Poly1305 frames */
+        assert(ascon128_init(&ascon_ctx, ascon_key, 32) != 0);
+        assert(ascon128_init(&ascon_ctx, ascon_key, sizeof(ascon_key)) == 0);
+        for (seqnr = 0; seqnr < 3; seqnr++) {
+            assert(ascon128_crypt(&ascon_ctx, seqnr, ciphertext_buf, sizeof(ciphertext_buf), plaintext_buf, 255, 1) == 0);
+            ascon128_get_length(&ascon_ctx, &out_len, seqnr, ciphertext_buf);
+            assert(out_len == 255);
+            assert(ascon128_crypt(&ascon_ctx, seqnr, plaintext_buf_new, 255, ciphertext_buf, sizeof(ciphertext_buf), 0) == 0);
+            assert(memcmp(plaintext_buf, plaintext_buf_new, 255) == 0);
+        }
+        assert(ascon128_crypt(&ascon_ctx, 0, plaintext_buf_new, 255, ciphertext_buf, sizeof(ciphertext_buf), 0) != 0);
+    }
+
+    /* test SipHash-2-4 (reference vectors, key = 00 01 .. 0f, message = 00 01 .. 0e) and MAC-only frames */
+    {
+        static const uint8_t siphash_kat_0[8] = {0x31, 0x0e, 0x0e, 0xdd, 0x47, 0xdb, 0x6f, 0x72};
+        static const uint8_t siphash_kat_15[8] = {0xe5, 0x45, 0xbe, 0x49, 0x61, 0xca, 0x29, 0xa1};
+        uint8_t sip_key[16], sip_in[8 + 255], sip_tag[8];
+        struct siphash_ctx sip_ctx;
+        uint64_t sip_seqnr = 0x0102030405060708ULL;
+
+        for (i = 0; i < 16; i++) {
+            sip_key[i] = sip_in[i] = i;
+        }
+        siphash24(sip_tag, sip_in, 0, sip_key);
+        assert(memcmp(sip_tag, siphash_kat_0, 8) == 0);
+        siphash24(sip_tag, sip_in, 15, sip_key);
+        assert(memcmp(sip_tag, siphash_kat_15, 8) == 0);
+
+        /* the frame tag is SipHash-2-4 of the little-endian seqnr followed by the frame */
+        assert(siphash24_mac_init(&sip_ctx, sip_key, sizeof(sip_key)) == 0);
+        assert(siphash24_mac_crypt(&sip_ctx, sip_seqnr, ciphertext_buf, sizeof(ciphertext_buf), plaintext_buf, 255, 1) == 0);
+        assert(memcmp(ciphertext_buf, plaintext_buf, 255) == 0);
+        for (i = 0; i < 8; i++) {
+            sip_in[i] = (uint8_t)(sip_seqnr >> (8 * i));
+        }
+        memcpy(sip_in + 8, plaintext_buf, 255);
+        siphash24(sip_tag, sip_in, sizeof(sip_in), sip_key);
+        assert(memcmp(ciphertext_buf + 255, sip_tag, 8) == 0);
+        siphash24_mac_get_length(&sip_ctx, &out_len, sip_seqnr, ciphertext_buf);
+        assert(out_len == 255);
+        assert(siphash24_mac_crypt(&sip_ctx, sip_seqnr, plaintext_buf_new, 255, ciphertext_buf, 255 + 8, 0) == 0);
+        assert(memcmp(plaintext_buf, plaintext_buf_new, 255) == 0);
+        assert(siphash24_mac_crypt(&sip_ctx, sip_seqnr + 1, plaintext_buf_new, 255, ciphertext_buf, 255 + 8, 0) != 0);
+        ciphertext_buf[100] ^= 1;
+        assert(siphash24_mac_crypt(&sip_ctx, sip_seqnr, plaintext_buf_new, 255, ciphertext_buf, 255 + 8, 0) != 0);
+    }
+
+    /* LZSS blocks round-trip */
+    {
+        const char* text = "\r\n0.01,-0.02,1.00,0.15,-0.24,0.06;\r\n0.01,-0.02,0.99,0.15,-0.23,0.06;";
+        int textlen = strlen(text);
+        uint8_t code[LZSS_MAX_ENCODED(128)];
+        uint8_t decoded[128];
+        int codelen = lzss_encode((const uint8_t*)text, textlen, code, sizeof(code));
+
+        assert(codelen > 0 && codelen < textlen);
+        assert(lzss_decode(code, codelen, decoded, sizeof(decoded)) == textlen);
+        assert(memcmp(text, decoded, textlen) == 0);
+        assert(lzss_encode((const uint8_t*)text, textlen, code, 4) == -1);
+        assert(lzss_decode(code, codelen, decoded, 4) == -1);
+    }
 }
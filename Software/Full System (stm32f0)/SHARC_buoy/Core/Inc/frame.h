@@ -0,0 +1,79 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary frames for the UART link. A frame is
+ * [type][2 byte sequence number][2 byte length][payload][2 byte CRC-16/CCITT-FALSE],
+ * little-endian, the CRC covering everything before it. The frame is COBS encoded, so it
+ * contains no zero bytes, and ends with a single 0x00, which the receiver synchronises on.
+ * The payload is carried byte for byte; COBS adds at most one byte per 254.
+ */
+
+#define FRAME_TYPE_HEADER   0x01 /* the column names of the readings, text */
+#define FRAME_TYPE_READINGS 0x02 /* a block of readings, text */
+#define FRAME_TYPE_RSA      0x03 /* RSA encrypted, then LZSS compressed block */
+#define FRAME_TYPE_SEALED   0x04 /* [suite][nonce][length][data][tag] from seal(), see aead_seal() in main.c */
+#define FRAME_TYPE_RECORDS  0x05 /* a block of readings, binary records (SHARC_RECORD_BINARY in sharc_config.h) */
+#define FRAME_TYPE_STATUS   0x06 /* the CPU load and the scheduler's figures, see send_status() in main.c */
+
+#define FRAME_SEALED_NONCE_LEN 8 /* the nonce of a sealed block, little-endian: boot number << 32 | block */
+
+/*
+ * A status frame is [2 byte CPU load][2 byte most CPU load][tasks], the loads in permille, then
+ * for every task [4 byte runs][4 byte busy us][4 byte longest run us][4 byte longest latency us]
+ * [2 byte deadline misses], in the order of schedTasks in main.c.
+ */
+#define FRAME_STATUS_TASK_LEN 18
+#define FRAME_STATUS_LEN(tasks) (5 + (tasks) * FRAME_STATUS_TASK_LEN)
+
+#define FRAME_HEADER_LEN 5
+#define FRAME_CRC_LEN 2
+#define FRAME_DELIMITER 0x00
+/* encoded size of a frame with n payload bytes, including the delimiter */
+#define FRAME_ENCODED_MAX(n) ((n) + FRAME_HEADER_LEN + FRAME_CRC_LEN + ((n) + FRAME_HEADER_LEN + FRAME_CRC_LEN) / 254 + 2)
+
+struct frame_writer {
+    uint8_t* dest;
+    size_t pos, code_pos;
+    uint8_t code;
+    uint16_t crc;
+};
+
+uint16_t frame_crc16(uint16_t crc, const uint8_t* data, size_t len);
+
+/*
+ * Writes a frame with len payload bytes to dest, which must hold FRAME_ENCODED_MAX(len) bytes:
+ * frame_begin(), len calls of frame_put(), then frame_end(), which returns the encoded size.
+ */
+void frame_begin(struct frame_writer* w, uint8_t* dest, uint8_t type, uint16_t seq, uint16_t len);
+void frame_put(struct frame_writer* w, uint8_t b);
+void frame_put_le(struct frame_writer* w, uint32_t v, int n); /* the n low bytes of v, little-endian */
+size_t frame_end(struct frame_writer* w);
+size_t frame_encode(uint8_t* dest, uint8_t type, uint16_t seq, const uint8_t* payload, uint16_t len);
+
+/* receiving side */
+#ifndef FRAME_PARSER_MAX
+#define FRAME_PARSER_MAX 1024 /* largest encoded frame accepted, without the delimiter */
+#endif
+
+struct frame {
+    uint8_t type;
+    uint16_t seq;
+    uint16_t len;
+    const uint8_t* payload; /* valid until the next frame_parse() */
+};
+
+struct frame_parser {
+    uint8_t buf[FRAME_PARSER_MAX];
+    size_t len;
+    int overflow;
+    unsigned long frames, errors; /* good frames, and frames dropped for their CRC, length or size */
+};
+
+void frame_parser_init(struct frame_parser* p);
+/* feeds one received byte; returns 1 when it completes a good frame, which is then in out */
+int frame_parse(struct frame_parser* p, uint8_t b, struct frame* out);
+#endif /* FRAME_H */
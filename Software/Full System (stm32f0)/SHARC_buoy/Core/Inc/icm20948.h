@@ -10,6 +10,7 @@
 #define	__ICM20948_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 
 /* User Configuration */
@@ -56,6 +57,22 @@ typedef struct
 	float z;
 } axises;
 
+// one sample of the accel and gyro: the 16 bits ADC values, and the same values in g and dps.
+typedef struct
+{
+	axises accel;
+	axises gyro;
+	axises accel_g;
+	axises gyro_dps;
+} icm20948_sample;
+
+// the 16 bits ADC values of one sample as the sensor gives them, for storing until they are converted.
+typedef struct
+{
+	int16_t accel[3];
+	int16_t gyro[3];
+} icm20948_raw;
+
 typedef enum
 {
 	power_down_mode = 0,
@@ -82,6 +99,37 @@ void icm20948_accel_read(axises* data);
 // Convert 16 bits ADC value to their unit.
 void icm20948_gyro_read_dps(axises* data); 
 void icm20948_accel_read_g(axises* data);
+
+// accel and gyro of one sample in one 12 byte SPI burst, kept as counts (short enough for an
+// interrupt handler), and converted to g and dps later.
+void icm20948_read_raw(icm20948_raw* raw);
+void icm20948_convert(const icm20948_raw* raw, icm20948_sample* sample);
+
+// Data ready interrupt: the INT pin pulses (50 us, active high) when a new sample is in the output registers.
+void icm20948_data_ready_int_enable();
+void icm20948_data_ready_int_disable();
+
+// FIFO: accel and gyro buffered by the sensor at the ODR, 12 bytes a sample (as the output registers).
+// The MCU can sleep while it fills and drain it in one SPI transfer.
+#define ICM20948_FIFO_SIZE				512
+#define ICM20948_FIFO_SAMPLE_LEN		12
+void icm20948_fifo_enable();
+void icm20948_fifo_disable();
+void icm20948_fifo_reset();
+uint16_t icm20948_fifo_count(); // bytes
+// raw samples, oldest first; returns how many (up to max) were read.
+int icm20948_fifo_read(icm20948_raw* raw, int max);
+
+// Burst read by DMA, without blocking: starts reading len bytes from reg into buf + 1 and returns.
+// buf[0] carries the address out (the SPI sends the buffer while it fills it), so buf holds len + 1.
+// HAL_SPI_RxCpltCallback() follows once the bytes are in, and must call icm20948_read_dma_end().
+// Returns false if the SPI is busy.
+bool icm20948_read_dma(userbank ub, uint8_t reg, uint8_t* buf, uint16_t len);
+void icm20948_read_dma_end();
+// what a burst read from B0_FIFO_COUNTH (2 bytes) and from the output registers or FIFO (12 bytes) holds.
+// Every sample read, polled or by DMA, is decoded by icm20948_decode_raw()
+uint16_t icm20948_fifo_count_decode(const uint8_t* data);
+void icm20948_decode_raw(const uint8_t* data, icm20948_raw* raw);
 //bool ak09916_mag_read_uT(axises* data);
 
 
@@ -94,6 +142,9 @@ void ak09916_soft_reset();
 
 void icm20948_wakeup();
 void icm20948_sleep();
+// accel and gyro duty-cycled between samples at the ODR (LP_EN), and back to low-noise mode
+void icm20948_low_power_enable();
+void icm20948_low_power_disable();
 
 void icm20948_spi_slave_enable();
 
@@ -31,17 +31,31 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "sharc_config.h"
+#include "icm20948.h"
+#include "sample_ring.h"
 /* USER CODE END Includes */
 
 /* Exported types ------------------------------------------------------------*/
 /* USER CODE BEGIN ET */
-
+// the block of readings on its way through the tasks, from sampling to transmission
+struct block {
+	char inputArray[SHARC_BLOCK_MAX + 2]; // the readings, then '}' and the terminator of the text records
+	int len; // bytes of readings in inputArray
+	uint16_t seq; // sequence number of the block, sent in its frames
+};
 /* USER CODE END ET */
 
 /* Exported constants --------------------------------------------------------*/
 /* USER CODE BEGIN EC */
+#if SAMPLE_RING_LEN < 2 * SHARC_BLOCK_READINGS
+#error "SAMPLE_RING_LEN must hold two blocks: the one being taken out and the next coming in"
+#endif
 
+/* Owner of DMA1 channel 4, which SPI2_RX (the sensor) and USART2_TX (the frames) share */
+#define DMA_CH4_FREE  0
+#define DMA_CH4_SPI   1
+#define DMA_CH4_UART  2
 /* USER CODE END EC */
 
 /* Exported macro ------------------------------------------------------------*/
@@ -53,10 +67,20 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
-
+void reset_block(void);
+void encrypt(char msg[], int len);
+int boot_next(uint32_t *boot);
+void aead_init(void);
+void seal(const uint8_t msg[], int len);
+char *put_hundredths(char *p, float v);
+int format_record(char *dest, const icm20948_sample *s);
+int pack_record(uint8_t *dest, const struct sample *s);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
+#define ICM_INT_Pin GPIO_PIN_11
+#define ICM_INT_GPIO_Port GPIOB
+#define ICM_INT_EXTI_IRQn EXTI4_15_IRQn
 #define SPI2_CS_Pin GPIO_PIN_12
 #define SPI2_CS_GPIO_Port GPIOB
 /* USER CODE BEGIN Private defines */
@@ -0,0 +1,48 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+#include "icm20948.h"
+#include "sharc_config.h"
+
+/*
+ * Lock-free single-producer, single-consumer ring of sensor samples. The ICM-20948's
+ * data-ready interrupt pushes, the main loop takes a block out once it is all in, so the
+ * sensor keeps being read while the main loop compresses, encrypts and transmits. Each
+ * side writes only its own index, and publishes it after the slots it covers, so neither
+ * needs to disable interrupts. The consumer reads the samples in place and releases them
+ * when it is done. The indices run freely and wrap at 2^16; the ring is a power of two
+ * long, which divides it.
+ */
+
+#ifndef SAMPLE_RING_LEN
+#define SAMPLE_RING_LEN SHARC_SAMPLE_RING_LEN /* samples, a power of two: two blocks of readings */
+#endif
+
+#if SAMPLE_RING_LEN & (SAMPLE_RING_LEN - 1)
+#error "SAMPLE_RING_LEN must be a power of two"
+#endif
+
+struct sample {
+    icm20948_raw raw;
+    uint16_t tick; /* HAL_GetTick() when it was read, wrapping */
+};
+
+struct sample_ring {
+    struct sample buf[SAMPLE_RING_LEN];
+    volatile uint16_t head;    /* next slot to write, producer only */
+    volatile uint16_t tail;    /* next slot to read, consumer only */
+    volatile uint16_t dropped; /* samples that found the ring full, producer only */
+};
+
+void sample_ring_init(struct sample_ring* r);
+/* producer: returns 0, and counts the sample as dropped, if the ring is full */
+int sample_ring_push(struct sample_ring* r, const struct sample* s);
+/* consumer: the i-th oldest sample, valid until it is released; i < sample_ring_count() */
+const struct sample* sample_ring_peek(const struct sample_ring* r, int i);
+/* consumer: frees the n oldest samples for the producer */
+void sample_ring_release(struct sample_ring* r, int n);
+/* samples waiting; exact for the consumer, a lower bound for anyone else */
+int sample_ring_count(const struct sample_ring* r);
+
+#endif
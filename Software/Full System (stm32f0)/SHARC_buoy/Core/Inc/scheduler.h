@@ -0,0 +1,56 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/*
+ * Cooperative run-to-completion scheduler. The tasks are a const table (in flash) with a
+ * statistics slot each in RAM, both allocated by the caller; nothing is allocated at run
+ * time. A task runs when it is made ready, by another task or an interrupt
+ * (sched_ready()), or every period_ms if it has a period. Of the ready tasks the one whose
+ * deadline comes first runs, to completion; a tie goes to the task first in the table.
+ *
+ * Every run is timed with SysTick to the microsecond. A task's latency is from being made
+ * ready (or due, for a periodic task) until its run ends, and a run whose latency exceeds
+ * deadline_ms counts as a miss. Times are uint32_t microseconds, which wrap after 71
+ * minutes; only differences are used.
+ */
+
+struct sched_task {
+    const char* name;
+    void (*run)(void* ctx);
+    uint16_t period_ms;   /* 0: runs when made ready */
+    uint16_t deadline_ms; /* from ready to done; 0: none, runs after those that have one */
+};
+
+struct sched_stats {
+    volatile uint8_t ready;
+    uint16_t misses;     /* runs that ended after their deadline */
+    uint32_t ready_us;   /* when it was made ready last, or fell due */
+    uint32_t runs;
+    uint32_t busy_us;    /* time spent running, wrapping */
+    uint32_t max_run_us;
+    uint32_t max_latency_us;
+};
+
+struct sched {
+    const struct sched_task* tasks;
+    struct sched_stats* stats;
+    int n;
+    void* ctx;                  /* passed to every task */
+    uint32_t load_us, load_busy_us; /* at the last sched_load() */
+};
+
+void sched_init(struct sched* s, const struct sched_task* tasks, struct sched_stats* stats, int n, void* ctx);
+/* makes task id ready, if it is not already; interrupt handlers may call it */
+void sched_ready(struct sched* s, int id);
+/* runs the ready task with the earliest deadline; returns 0 if none was ready */
+int sched_run(struct sched* s);
+/* 1 if a task is ready to run */
+int sched_busy(const struct sched* s);
+/* the share of the time since the last call the tasks were running, in permille */
+uint16_t sched_load(struct sched* s);
+/* microseconds since HAL_Init(), from HAL_GetTick() and SysTick's count */
+uint32_t sched_time_us(void);
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SHARC_CONFIG_H
+#define SHARC_CONFIG_H
+
+/*
+ * Build configuration of the SHARC buoy firmware. Every option can be set on the compiler's
+ * command line (-DSHARC_...=N) instead of here. The sizes of the buffers a block passes
+ * through (readings, LZSS code, sealed frame, sample ring) follow from the options below,
+ * so no array in main.c has to be resized by hand. main.c checks at compile time that the
+ * worst case of each stage fits the next one and that the buffers fit the RAM.
+ */
+
+/* Cipher applied to each block of readings before it is transmitted */
+#define SHARC_CIPHER_RSA         0  // per-byte RSA, then LZSS compression (original pipeline)
+#define SHARC_CIPHER_CHACHAPOLY  1  // LZSS compression, then a ChaCha20-Poly1305 sealed frame
+#define SHARC_CIPHER_ASCON       2  // LZSS compression, then an Ascon-128 sealed frame
+#define SHARC_CIPHER_SIPHASH     3  // LZSS compression, then a SipHash-2-4 tag only (tamper-evident, not secret)
+
+#ifndef SHARC_CIPHER
+#define SHARC_CIPHER SHARC_CIPHER_RSA
+#endif
+
+/* ChaCha rounds for SHARC_CIPHER_CHACHAPOLY: 20, or 12/8 to save energy. Sent in every frame header */
+#ifndef SHARC_CHACHA_ROUNDS
+#define SHARC_CHACHA_ROUNDS 20
+#endif
+
+/* Format of the UART output */
+#define SHARC_LINK_TEXT    0  // readings as text, then every code byte as "\r\n%d," (what Scripts/clean.py expects)
+#define SHARC_LINK_FRAMES  1  // COBS delimited binary frames with type, sequence number, length and CRC (frame.h)
+
+#ifndef SHARC_LINK
+#define SHARC_LINK SHARC_LINK_FRAMES
+#endif
+
+/* SHARC_LINK_FRAMES: seconds between status frames (CPU load and task figures, frame.h); 0 for none */
+#ifndef SHARC_STATUS_PERIOD_S
+#define SHARC_STATUS_PERIOD_S 10
+#endif
+
+/* Format of the readings in a block */
+#define SHARC_RECORD_TEXT    0  // "\r\n%.2f,...;" per reading, at most SHARC_READING_TEXT_MAX characters
+#define SHARC_RECORD_BINARY  1  // the six raw sensor counts as little-endian int16 (12 bytes), see pack_record() in main.c
+
+#ifndef SHARC_RECORD
+#define SHARC_RECORD SHARC_RECORD_TEXT
+#endif
+
+/* SHARC_RECORD_BINARY: 1 adds the milliseconds since the previous reading to every record */
+#ifndef SHARC_RECORD_TIMESTAMP
+#define SHARC_RECORD_TIMESTAMP 0
+#endif
+
+#define SHARC_RECORD_LEN (12 + 2 * SHARC_RECORD_TIMESTAMP) // bytes per binary record
+
+/* Readings per block: compressed, encrypted and sent together */
+#ifndef SHARC_BLOCK_READINGS
+#define SHARC_BLOCK_READINGS 10
+#endif
+
+/* Readings are taken on the ICM-20948's data-ready interrupt, at 1.125 kHz / (1 + divider); 0..255 */
+#ifndef SHARC_SAMPLE_RATE_DIV
+#define SHARC_SAMPLE_RATE_DIV 255 // 4.4 Hz
+#endif
+
+/* Power between samples */
+#define SHARC_POWER_RUN  0  // the MCU sleeps (WFI) between interrupts, the sensor samples in low-noise mode
+#define SHARC_POWER_LOW  1  // the MCU stops (STOP) when no DMA is on its way, the sensor duty-cycles (cycle mode)
+
+#ifndef SHARC_POWER
+#define SHARC_POWER SHARC_POWER_LOW
+#endif
+
+/* LZSS: a 2^EI byte window and matches of 2..2^EJ + 1 bytes. The ground decoder must use the same */
+#ifndef SHARC_LZSS_EI
+#define SHARC_LZSS_EI 6 // typically 10..13; the window is kept twice (2^(EI+1) bytes), so 6 on the STM32F0
+#endif
+#ifndef SHARC_LZSS_EJ
+#define SHARC_LZSS_EJ 5 // typically 4..5
+#endif
+#ifndef SHARC_LZSS_P
+#define SHARC_LZSS_P ((1 + SHARC_LZSS_EI + SHARC_LZSS_EJ) / 9) // matches of up to P bytes are sent as literals
+#endif
+
+/* RAM of the STM32F051R8 and what the linker script keeps of it for the stack and the heap */
+#ifndef SHARC_RAM_SIZE
+#define SHARC_RAM_SIZE 8192
+#endif
+#define SHARC_STACK_SIZE 0x400 // _Min_Stack_Size in STM32F051R8TX_FLASH.ld
+#define SHARC_HEAP_SIZE 0x200  // _Min_Heap_Size
+#define SHARC_RAM_OTHER 1024   // HAL handles, scheduler, counters and the C library's data
+
+/*
+ * Derived sizes, in bytes. A text record is "\r\n", three accelerations in g at the 2 g full
+ * scale ("-2.00"), three rates in dps at the 2000 dps full scale ("-1998.05", -32768 / 16.4),
+ * five commas and the ';'.
+ */
+#define SHARC_READING_TEXT_MAX (2 + 3 * 5 + 3 * 8 + 5 + 1)
+#if SHARC_RECORD == SHARC_RECORD_BINARY
+#define SHARC_READING_MAX SHARC_RECORD_LEN
+#else
+#define SHARC_READING_MAX SHARC_READING_TEXT_MAX
+#endif
+#define SHARC_BLOCK_MAX (SHARC_BLOCK_READINGS * SHARC_READING_MAX) // the readings of a block
+
+// LZSS codes a literal as a flag bit and the byte, and a match in no more bits than the
+// literals it replaces (checked below), so n bytes never take more than 9n bits
+#define SHARC_LZSS_MAX(n) ((9 * (n) + 7) / 8)
+#define SHARC_CODE_MAX SHARC_LZSS_MAX(SHARC_BLOCK_MAX) // the compressed block, RSA encrypted or not
+
+// the buffers main.c checks against the RAM (see the _Static_assert there)
+#define SHARC_RAM_BUFFERS_MAX (SHARC_RAM_SIZE - SHARC_STACK_SIZE - SHARC_HEAP_SIZE - SHARC_RAM_OTHER)
+
+// the sample ring holds two blocks (sample_ring.h), rounded up to a power of two
+#if 2 * SHARC_BLOCK_READINGS <= 16
+#define SHARC_SAMPLE_RING_LEN 16
+#elif 2 * SHARC_BLOCK_READINGS <= 32
+#define SHARC_SAMPLE_RING_LEN 32
+#elif 2 * SHARC_BLOCK_READINGS <= 64
+#define SHARC_SAMPLE_RING_LEN 64
+#elif 2 * SHARC_BLOCK_READINGS <= 128
+#define SHARC_SAMPLE_RING_LEN 128
+#elif 2 * SHARC_BLOCK_READINGS <= 256
+#define SHARC_SAMPLE_RING_LEN 256
+#elif 2 * SHARC_BLOCK_READINGS <= 512
+#define SHARC_SAMPLE_RING_LEN 512
+#else
+#error "SHARC_BLOCK_READINGS is too large for the sample ring"
+#endif
+
+#if SHARC_BLOCK_READINGS < 1
+#error "SHARC_BLOCK_READINGS must be at least 1"
+#endif
+#if SHARC_LZSS_EJ >= SHARC_LZSS_EI
+#error "SHARC_LZSS_EJ must be less than SHARC_LZSS_EI: the lookahead has to fit the window"
+#endif
+#if 1 + SHARC_LZSS_EI + SHARC_LZSS_EJ > 9 * (SHARC_LZSS_P + 1)
+#error "an LZSS match must not take more bits than the literals it replaces, or SHARC_CODE_MAX is too small"
+#endif
+#if SHARC_RECORD == SHARC_RECORD_BINARY && SHARC_LINK != SHARC_LINK_FRAMES
+#error "SHARC_RECORD_BINARY needs SHARC_LINK_FRAMES: the text link cannot carry binary readings"
+#endif
+#if SHARC_RECORD == SHARC_RECORD_BINARY && SHARC_CIPHER == SHARC_CIPHER_RSA
+#error "SHARC_RECORD_BINARY needs an AEAD cipher: RSA with n = 187 cannot encrypt bytes above 186"
+#endif
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Binary frames for the UART link (see frame.h): COBS (Cheshire, Baker) with a zero
+ * delimiter, and a bitwise CRC-16/CCITT-FALSE, which needs no table in flash.
+ */
+
+#include "frame.h"
+
+#include <string.h>
+
+uint16_t frame_crc16(uint16_t crc, const uint8_t* data, size_t len)
+{
+    int i;
+    while (len--) {
+        crc ^= (uint16_t)*data++ << 8;
+        for (i = 0; i < 8; i++)
+            crc = crc & 0x8000 ? (uint16_t)(crc << 1) ^ 0x1021 : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/* COBS: every run of up to 254 non-zero bytes is preceded by its length + 1 instead of a zero */
+static void cobs_put(struct frame_writer* w, uint8_t b)
+{
+    if (b != 0) {
+        w->dest[w->pos++] = b;
+        w->code++;
+    }
+    if (b == 0 || w->code == 0xFF) {
+        w->dest[w->code_pos] = w->code;
+        w->code_pos = w->pos++;
+        w->code = 1;
+    }
+}
+
+static void put_raw(struct frame_writer* w, uint8_t b)
+{
+    w->crc = frame_crc16(w->crc, &b, 1);
+    cobs_put(w, b);
+}
+
+void frame_begin(struct frame_writer* w, uint8_t* dest, uint8_t type, uint16_t seq, uint16_t len)
+{
+    w->dest = dest;
+    w->code_pos = 0;
+    w->pos = 1;
+    w->code = 1;
+    w->crc = 0xFFFF;
+    put_raw(w, type);
+    put_raw(w, seq & 0xFF);
+    put_raw(w, seq >> 8);
+    put_raw(w, len & 0xFF);
+    put_raw(w, len >> 8);
+}
+
+void frame_put(struct frame_writer* w, uint8_t b)
+{
+    put_raw(w, b);
+}
+
+void frame_put_le(struct frame_writer* w, uint32_t v, int n)
+{
+    while (n--) {
+        put_raw(w, v & 0xFF);
+        v >>= 8;
+    }
+}
+
+size_t frame_end(struct frame_writer* w)
+{
+    uint16_t crc = w->crc;
+    cobs_put(w, crc & 0xFF);
+    cobs_put(w, crc >> 8);
+    w->dest[w->code_pos] = w->code;
+    w->dest[w->pos++] = FRAME_DELIMITER;
+    return w->pos;
+}
+
+size_t frame_encode(uint8_t* dest, uint8_t type, uint16_t seq, const uint8_t* payload, uint16_t len)
+{
+    struct frame_writer w;
+    uint16_t i;
+    frame_begin(&w, dest, type, seq, len);
+    for (i = 0; i < len; i++)
+        frame_put(&w, payload[i]);
+    return frame_end(&w);
+}
+
+void frame_parser_init(struct frame_parser* p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+/* decodes the COBS frame in buf in place; returns its decoded length, or -1 */
+static int cobs_decode(uint8_t* buf, size_t len)
+{
+    size_t in = 0, out = 0;
+    uint8_t code, i;
+    while (in < len) {
+        code = buf[in++];
+        if (code == 0 || in + code - 1 > len)
+            return -1;
+        for (i = 1; i < code; i++)
+            buf[out++] = buf[in++];
+        if (code != 0xFF && in < len)
+            buf[out++] = 0;
+    }
+    return (int)out;
+}
+
+int frame_parse(struct frame_parser* p, uint8_t b, struct frame* out)
+{
+    int len, ok;
+    uint16_t crc;
+
+    if (b != FRAME_DELIMITER) {
+        if (p->len < sizeof(p->buf))
+            p->buf[p->len++] = b;
+        else
+            p->overflow = 1;
+        return 0;
+    }
+    if (p->len == 0)
+        return 0; /* back-to-back delimiters */
+    len = p->overflow ? -1 : cobs_decode(p->buf, p->len);
+    p->len = 0;
+    p->overflow = 0;
+    ok = len >= FRAME_HEADER_LEN + FRAME_CRC_LEN;
+    if (ok) {
+        out->type = p->buf[0];
+        out->seq = p->buf[1] | p->buf[2] << 8;
+        out->len = p->buf[3] | p->buf[4] << 8;
+        out->payload = p->buf + FRAME_HEADER_LEN;
+        crc = p->buf[len - 2] | p->buf[len - 1] << 8;
+        ok = out->len == len - FRAME_HEADER_LEN - FRAME_CRC_LEN &&
+             frame_crc16(0xFFFF, p->buf, len - FRAME_CRC_LEN) == crc;
+    }
+    if (!ok) {
+        p->errors++;
+        return 0;
+    }
+    p->frames++;
+    return 1;
+}
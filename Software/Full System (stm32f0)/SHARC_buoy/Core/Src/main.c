@@ -18,9 +18,17 @@ The icm20948.h and other methods are adapted from mokhwasomssi's github
 
 In future versions, the data will be read from the sensor HAT ICM2098 chip.
 
-NOTE: When increasing the input data, the input data, compression and encryption
-      array sizes also need to be increased. Otherwise the program will crash/not
-      run correctly.
+Setting SHARC_CIPHER (sharc_config.h) to SHARC_CIPHER_CHACHAPOLY or SHARC_CIPHER_ASCON replaces
+the RSA step with a ChaCha20-Poly1305 or Ascon-128 AEAD: each block is compressed first
+and then sealed as one frame. SHARC_CIPHER_SIPHASH only tags the compressed block.
+
+With SHARC_LINK_FRAMES (sharc_config.h) the header, the readings and the code of every block are
+sent as binary frames (frame.h) instead of text; Scripts/frames.py receives them.
+SHARC_RECORD_BINARY stores the readings as raw sensor counts instead of formatted text.
+
+NOTE: The block, compression and encryption arrays are sized from the readings per block,
+      the record format and the LZSS window in sharc_config.h; the build fails if they
+      no longer fit the RAM.
 ******************************************************************************
 */
 /* USER CODE END Header */
@@ -34,6 +42,12 @@ NOTE: When increasing the input data, the input data, compression and encryption
 #include "stdlib.h"
 #include "math.h"
 #include "string.h"
+#include "ascon_aead.h"
+#include "chachapoly_aead.h"
+#include "poly1305.h"
+#include "siphash.h"
+#include "frame.h"
+#include "scheduler.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -44,12 +58,40 @@ NOTE: When increasing the input data, the input data, compression and encryption
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
 /* FOR COMPRESSION */
-#define EI  6  // typically 10..13 - due to the limited ability of the STM, 6 is used
-#define EJ  5  // typically 4..5
-#define P   1  //If match length <= P then output one character
+#define EI  SHARC_LZSS_EI  // sharc_config.h
+#define EJ  SHARC_LZSS_EJ
+#define P   SHARC_LZSS_P  //If match length <= P then output one character
 #define N (1 << EI)  // buffer size
 #define F ((1 << EJ) + 1)  // lookahead buffer size
 
+/* FOR SAMPLING */
+#define SENSOR_BURST_MAX 4 // FIFO samples per DMA burst; more are read by the next one
+#define SAMPLE_PERIOD_US ((1 + SHARC_SAMPLE_RATE_DIV) * 1000000UL / 1125) // the sensor's ODR period
+#define SENSOR_IDLE 0 // sensorState: no transfer on its way
+#define SENSOR_COUNT 1 // reading the FIFO count
+#define SENSOR_SAMPLES 2 // reading the samples it counted
+
+/* FOR SCHEDULING */
+#define TASK_SAMPLING 0 // schedTasks[]
+#define TASK_COMPRESSION 1
+#define TASK_CRYPTO 2
+#define TASK_TRANSMISSION 3
+#define TASK_HOUSEKEEPING 4
+#define TASKS 5
+// a block comes in every BLOCK_PERIOD_MS: compression, crypto and transmission share it,
+// so the pipeline keeps up. Sampling has until the ring behind the block fills, or the
+// 65 s a deadline_ms can hold
+#define BLOCK_PERIOD_MS (SHARC_BLOCK_READINGS * SAMPLE_PERIOD_US / 1000)
+#define RING_SLACK_MS ((SAMPLE_RING_LEN - SHARC_BLOCK_READINGS) * SAMPLE_PERIOD_US / 1000)
+#define SAMPLING_DEADLINE_MS (RING_SLACK_MS < UINT16_MAX ? RING_SLACK_MS : UINT16_MAX)
+#define COMPRESSION_DEADLINE_MS (BLOCK_PERIOD_MS / 4)
+#define CRYPTO_DEADLINE_MS (BLOCK_PERIOD_MS / 4)
+#define TRANSMISSION_DEADLINE_MS (BLOCK_PERIOD_MS / 2)
+#define HOUSEKEEPING_PERIOD_MS 1000
+
+/* FOR POWER (SHARC_POWER_LOW) */
+#define STOP_WAKEUP_US 5 // from the wakeup event to running again after STOP: the F051's tWUSTOP
+
 /* FOR ENCRYPTION */
 //these variables are used when a dynamic key is implemented for encryption
 //#define MAX_VALUE 16 // size of key
@@ -64,38 +106,101 @@ NOTE: When increasing the input data, the input data, compression and encryption
 /* Private variables ---------------------------------------------------------*/
 SPI_HandleTypeDef hspi2;
 UART_HandleTypeDef huart2;
+DMA_HandleTypeDef hdma_usart2_tx;
 
 /* USER CODE BEGIN PV */
 // IMU VARIABLES
-axises my_gyro;
-axises my_accel;
-axises my_mag;
+struct sample_ring sampleRing; // filled by the data-ready interrupt, emptied by the main loop
+// the FIFO count or samples on their way in by DMA, after the address slot (icm20948_read_dma())
+static uint8_t sensorDma[1 + SENSOR_BURST_MAX * ICM20948_FIFO_SAMPLE_LEN];
+static volatile uint8_t sensorState = SENSOR_IDLE;
+static volatile uint8_t sensorReadPending; // samples came in while the SPI or its DMA channel was busy
+static uint8_t sensorBurst; // samples in the SENSOR_SAMPLES transfer
 
 static float gyro_scale_factor;
 static float accel_scale_factor;
+static int user_bank = -1; // the bank REG_BANK_SEL is set to, -1 until it is known
 
 // COMPRESSION VARIABLES
 int numRecordings =0; // this keeps track of the number of recordings.
 
 int bit_buffer = 0, bit_mask = 128;
-int buffer[N * 2];
-int compressed[500]; // size of data to compress at one time (should be at least the size of encryption array)
+uint8_t buffer[N * 2]; // the LZSS window; it only ever holds bytes
+int8_t compressed[SHARC_CODE_MAX]; // the LZSS code of a block, as the signed bytes the text link sends
 int compressedBits =0; //keep track of compressed bits for transmission
 
 // ENCRYPTION VARIABLES
-int e = 3;
-int n = 187;
-int d = 107;
-int p = 11;
-int q = 17;
-int encryptedData[500]; // passed to compression
+static const int e = 3;
+static const int n = 187;
+// the ground decrypts with d = 107 (n = p * q, p = 11, q = 17)
+uint8_t encryptedData[SHARC_BLOCK_MAX]; // passed to compression: RSA code (< n) or the plaintext block
 int encryptedBits = 0; // needed for use in compression
 
+// AEAD VARIABLES (SHARC_CIPHER_CHACHAPOLY, SHARC_CIPHER_ASCON, SHARC_CIPHER_SIPHASH)
+// the keys are fixed like the RSA key above; each buoy should be provisioned with its own pair.
+// Each is only built in where aead_init() keys a suite with it (RSA builds key ChaCha20-Poly1305)
+#if SHARC_CIPHER != SHARC_CIPHER_SIPHASH
+static const uint8_t aead_k_1[CHACHA20_POLY1305_AEAD_KEY_LEN] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+	0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+#endif
+#if SHARC_CIPHER != SHARC_CIPHER_ASCON
+static const uint8_t aead_k_2[CHACHA20_POLY1305_AEAD_KEY_LEN] = {
+	0xff, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+	0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+#endif
+struct chachapolyaead_ctx aead_ctx;
+struct asconaead_ctx ascon_ctx; // keyed with the first ASCON128_KEY_LEN bytes of aead_k_1
+struct siphash_ctx siphash_ctx; // keyed with the first SIPHASH_KEY_LEN bytes of aead_k_2
+uint64_t seqnr = 0; // the nonce: the boot number (boot_next()) in the high 32 bits, the block in the low
+// suite + 8 byte nonce + 3 byte length + compressed block + 16 byte tag
+uint8_t sealedData[1 + FRAME_SEALED_NONCE_LEN + CHACHA20_POLY1305_AEAD_AAD_LEN + SHARC_CODE_MAX + POLY1305_TAGLEN];
+int sealedBytes = 0;
+
+// DMA VARIABLES
+// SPI2_RX and USART2_TX can only use DMA1 channel 4 (the F051 cannot remap them), so it is
+// lent to one at a time. SPI2_TX has channel 5 to itself
+DMA_HandleTypeDef hdma_spi2_rx; // set up in HAL_SPI_MspInit()
+DMA_HandleTypeDef hdma_spi2_tx;
+volatile uint8_t dmaCh4Owner = DMA_CH4_FREE;
+
+// LINK VARIABLES (SHARC_LINK_FRAMES)
+// ping-pong frame buffers: one is sent by DMA while the next frame is encoded into the other.
+// The largest payload is a sealed block or the status; the RSA code and the readings are smaller
+#define TX_PAYLOAD_MAX (sizeof(sealedData) > FRAME_STATUS_LEN(TASKS) ? sizeof(sealedData) : FRAME_STATUS_LEN(TASKS))
+uint8_t txFrame[2][FRAME_ENCODED_MAX(TX_PAYLOAD_MAX)];
+_Static_assert(sizeof(sealedData) <= UINT16_MAX, "a sealed block does not fit the 16 bit length of a frame");
+static uint16_t txLen[2];
+static volatile uint8_t txBusy[2]; // on the air, or waiting for the other buffer to finish
+static volatile int8_t txActive = -1; // the buffer on the air, -1 if the UART is idle
+static int txNext = 0; // the buffer the next frame is encoded into
+static volatile uint8_t txRetry; // the UART did not take the last frame started: tx_retry() starts it again
+unsigned long txWaits = 0; // frames that had to wait for a free buffer
+unsigned long txRetries = 0; // frames the UART did not take at the first start
+
+// SCHEDULER VARIABLES
+struct sched sched;
+struct sched_stats schedStats[TASKS];
+static volatile uint8_t blockBusy; // a block is between sampling and transmission
+uint16_t cpuLoad, cpuLoadMax; // permille of the last housekeeping period, and the most of any
+static uint16_t statusSeq; // sequence number of the next status frame
+
+// POWER VARIABLES (SHARC_POWER_LOW)
+#if SHARC_POWER == SHARC_POWER_LOW
+static volatile uint32_t lastIntUs; // sched_time_us() at the last data-ready interrupt
+static volatile uint8_t intSeen; // lastIntUs is set: the sensor's interrupts are timing the STOPs
+static volatile uint8_t intLateUs; // the next data-ready interrupt runs this late: it woke STOP
+static uint32_t stopCarryUs; // time stopped not yet added to the tick, under a millisecond
+#endif
+
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
 void SystemClock_Config(void);
 static void MX_GPIO_Init(void);
+static void MX_DMA_Init(void);
 static void MX_SPI2_Init(void);
 static void MX_USART2_UART_Init(void);
 /* USER CODE BEGIN PFP */
@@ -104,6 +209,19 @@ void icm20948_gyro_read(axises* data);
 void icm20948_accel_read(axises* data);
 void icm20948_gyro_read_dps(axises* data);
 void icm20948_accel_read_g(axises* data);
+void icm20948_read_raw(icm20948_raw* raw);
+void icm20948_convert(const icm20948_raw* raw, icm20948_sample* sample);
+void icm20948_data_ready_int_enable();
+void icm20948_data_ready_int_disable();
+void icm20948_fifo_enable();
+void icm20948_fifo_disable();
+void icm20948_fifo_reset();
+uint16_t icm20948_fifo_count();
+int icm20948_fifo_read(icm20948_raw* raw, int max);
+bool icm20948_read_dma(userbank ub, uint8_t reg, uint8_t* buf, uint16_t len);
+void icm20948_read_dma_end();
+uint16_t icm20948_fifo_count_decode(const uint8_t* data);
+void icm20948_decode_raw(const uint8_t* data, icm20948_raw* raw);
 /* Sub Functions */
 void icm20948_accel_full_scale_select(accel_full_scale full_scale);
 void icm20948_gyro_full_scale_select(gyro_full_scale full_scale);
@@ -118,6 +236,8 @@ void icm20948_clock_source(uint8_t source);
 void icm20948_spi_slave_enable();
 void icm20948_sleep();
 void icm20948_wakeup();
+void icm20948_low_power_enable();
+void icm20948_low_power_disable();
 void icm20948_device_reset();
 bool icm20948_who_am_i();
 /*Static functions*/
@@ -136,13 +256,51 @@ void putbit1(void);
 void flush_bit_buffer(void);
 void output1(int c);
 void output2(int x, int y);
-void compress(int encryptedData[], int encryptedBits);
+void compress(const uint8_t encryptedData[], int encryptedBits);
 int ENCmodpow(int base, int power, int mod);
-void encrypt(char msg[]);
+void rsa_encrypt(char msg[], int len);
+void encrypt(char msg[], int len);
+void reset_block(void);
+void aead_init(void);
+void aead_stage(const uint8_t msg[], int len);
+void aead_seal(void);
+void seal(const uint8_t msg[], int len);
+char *put_hundredths(char *p, float v);
+int format_record(char *dest, const icm20948_sample *s);
+int pack_record(uint8_t *dest, const struct sample *s);
+void sensor_read_start(void);
+int dma_ch4_take(uint8_t owner);
+void dma_ch4_release(void);
+int tx_acquire(void);
+void tx_start(void);
+void tx_retry(void);
+void tx_submit(int i, size_t size);
+void send_frame(uint8_t type, uint16_t seq, const uint8_t *payload, int len);
+int send_status(void);
+void send_code_frame(uint16_t seq);
+void power_idle(void);
+void task_sampling(void *ctx);
+void task_compression(void *ctx);
+void task_crypto(void *ctx);
+void task_transmission(void *ctx);
+void task_housekeeping(void *ctx);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
+const struct sched_task schedTasks[TASKS] = {
+	{ "sampling", task_sampling, 0, SAMPLING_DEADLINE_MS },
+	{ "compression", task_compression, 0, COMPRESSION_DEADLINE_MS },
+	{ "crypto", task_crypto, 0, CRYPTO_DEADLINE_MS },
+	{ "transmission", task_transmission, 0, TRANSMISSION_DEADLINE_MS },
+	{ "housekeeping", task_housekeeping, HOUSEKEEPING_PERIOD_MS, HOUSEKEEPING_PERIOD_MS },
+};
+
+// the buffers sized in sharc_config.h must leave the stack, the heap and SHARC_RAM_OTHER their share
+_Static_assert(sizeof(struct block) + sizeof(sampleRing) + sizeof(sensorDma) + sizeof(buffer) + sizeof(compressed) +
+		sizeof(encryptedData) + sizeof(sealedData) + sizeof(txFrame) + sizeof(aead_ctx) + sizeof(ascon_ctx) +
+		sizeof(siphash_ctx) <= SHARC_RAM_BUFFERS_MAX,
+		"the block buffers do not fit the RAM: lower SHARC_BLOCK_READINGS or SHARC_LZSS_EI (sharc_config.h)");
 /* USER CODE END 0 */
 
 /**
@@ -173,23 +331,48 @@ int main(void)
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
+  MX_DMA_Init();
   MX_SPI2_Init();
   MX_USART2_UART_Init();
   /* USER CODE BEGIN 2 */
 
   icm20948_init();
  // ak09916_init();
+#if SHARC_CIPHER != SHARC_CIPHER_RSA
+  aead_init();
+#endif
 
   //This displays the header which explains the formating of the data outputted.
+#if SHARC_RECORD == SHARC_RECORD_BINARY
+  // the records hold sensor counts; the header gives the counts per unit
+  uint8_t header[160];
+  int a = (int)accel_scale_factor, g = (int)(gyro_scale_factor * 10 + 0.5f); // 16384, 16.4
+  sprintf((char*)header, "\r\nAccel X (g/%d),Accel Y (g/%d),Accel Z (g/%d),Gyro X (dps/%d.%d),Gyro Y (dps/%d.%d),Gyro Z (dps/%d.%d)%s",
+		  a, a, a, g / 10, g % 10, g / 10, g % 10, g / 10, g % 10, SHARC_RECORD_TIMESTAMP ? ",dt (ms)" : "");
+#else
   uint8_t header[77];
   sprintf((char*)header, "\r\nAccel X (g),Accel Y (g),Accel Z (g),Gyro X (dps),Gyro Y (dps),Gyro Z (dps)");
+#endif
+#if SHARC_LINK == SHARC_LINK_FRAMES
+  send_frame(FRAME_TYPE_HEADER, 0, header + 2, strlen((char*)header) - 2);
+#else
   HAL_UART_Transmit(&huart2, header, sizeof(header), 1000);
-
-  int numReadings = 10; // number of sensor readings you want to take
-  int numDataRecordings =0;
-  int run = 0; // whether or not to run encrypt&compress
-
-  char inputArray[390] =""; // size = numReadings * 37+1
+#endif
+
+  static struct block blk = { .inputArray = "" }; // one block at a time goes through the tasks
+
+  // from here on the sensor is read on its data-ready interrupt (and the SPI used by it only),
+  // so sampling goes on while a block is compressed, encrypted and sent. The samples go
+  // through the sensor's FIFO, which keeps them while the DMA channel is lent to the UART
+  sched_init(&sched, schedTasks, schedStats, TASKS, &blk);
+  sample_ring_init(&sampleRing);
+  icm20948_gyro_sample_rate_divider(SHARC_SAMPLE_RATE_DIV);
+  icm20948_accel_sample_rate_divider(SHARC_SAMPLE_RATE_DIV);
+  icm20948_fifo_enable();
+#if SHARC_POWER == SHARC_POWER_LOW
+  icm20948_low_power_enable();
+#endif
+  icm20948_data_ready_int_enable();
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -199,62 +382,16 @@ int main(void)
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
-	// raw data
-	icm20948_accel_read(&my_accel);
-	icm20948_gyro_read(&my_gyro);
-
-	// or unit conversion
-	icm20948_gyro_read_dps(&my_gyro);
-	icm20948_accel_read_g(&my_accel);
-
-	if(numDataRecordings <=numReadings-1){
-		/*
-		 * If any changes are made to the formatting of the readings, inputArray[] size needs to be updated.
-		 * The reading array size must also be updated. The strncat() must also be updated.
-		 */
-		char reading[40];
-		sprintf(reading, "\r\n%.2f,%.2f,%.2f,%.2f,%.2f,%.2f;",my_accel.x,my_accel.y,my_accel.z,
-				my_gyro.x,my_gyro.y,my_gyro.z);
-		// HAL_UART_Transmit(&huart2, (uint8_t*)reading, sizeof(reading), 1000);
-
-		strncat(inputArray,reading,37); //if reading formatting is changed this length needs to be updated
-
-		if(numDataRecordings ==numReadings-1){
-			strcat(inputArray,"}");
-			HAL_UART_Transmit(&huart2, (uint8_t*)inputArray, sizeof(inputArray), 1000);
-			HAL_Delay(1000);
-			run++;
-		}
-		numDataRecordings++;
-	}
-
-	/* Run compression and encryption */
-	if (run ==1) {
-		char start[4];
-		sprintf(start, "\r\n#");
-		HAL_UART_Transmit(&huart2, (uint8_t*)start, sizeof(start), 1000);
-
-		encrypt(inputArray);
-		int count = 0;
-		while (count < compressedBits) {
-			char temp [7];
-			/*
-			 * note that the numbers are of different lengths and so this causes extra blank space in the formatting
-			 * which the transmission will fill with random characters. Make sure to used clean.py or adapt it to remove
-			 * the unwanted characters.
-			 */
-			sprintf(temp, "\r\n%d,",compressed[count]);
-			HAL_UART_Transmit(&huart2, (uint8_t*)temp, sizeof(temp), 1000);
-			count++;
-		}
-		// TO ONLY TRANSMIT ONCE, COMMENT THESE LINES OUT
-		/** Reset the values for continued transmission **/
-		run=1;
-		numDataRecordings = 0;
-		memset(inputArray, 0, sizeof(inputArray));
-		HAL_Delay(5000); //add a delay before getting next block of recordings
+	/*
+	 * A pipeline of three blocks, run by the tasks in schedTasks[]: sampling takes block k
+	 * out of sampleRing once all its samples are in, compression and crypto follow (in the
+	 * cipher's order), then transmission, which lets sampling take block k + 1. Meanwhile
+	 * the interrupt reads block k + 1 into the ring behind it, and block k - 1 is still on
+	 * the air (tx_submit()).
+	 */
+	if (!sched_run(&sched)) {
+		power_idle(); // nothing ready: sleep until the next sample, frame sent or SysTick
 	}
-
   }
   /* USER CODE END 3 */
 }
@@ -369,6 +506,22 @@ static void MX_USART2_UART_Init(void)
 
 }
 
+/**
+  * Enable DMA controller clock
+  */
+static void MX_DMA_Init(void)
+{
+
+  /* DMA controller clock enable */
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* DMA interrupt init */
+  /* DMA1_Channel4_5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA1_Channel4_5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_5_IRQn);
+
+}
+
 /**
   * @brief GPIO Initialization Function
   * @param None
@@ -392,6 +545,16 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(SPI2_CS_GPIO_Port, &GPIO_InitStruct);
 
+  /*Configure GPIO pin : ICM_INT_Pin */
+  GPIO_InitStruct.Pin = ICM_INT_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  HAL_GPIO_Init(ICM_INT_GPIO_Port, &GPIO_InitStruct);
+
+  /* EXTI interrupt init*/
+  HAL_NVIC_SetPriority(EXTI4_15_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_15_IRQn);
+
 }
 
 /* USER CODE BEGIN 4 */
@@ -474,6 +637,58 @@ void icm20948_accel_read_g(axises* data)
 	data->z /= accel_scale_factor;
 }
 
+void icm20948_read_raw(icm20948_raw* raw)
+{
+	// ACCEL_XOUT_H to GYRO_ZOUT_L are consecutive, so one burst reads them all
+	icm20948_decode_raw(read_multiple_icm20948_reg(ub_0, B0_ACCEL_XOUT_H, 12), raw);
+}
+
+void icm20948_decode_raw(const uint8_t* data, icm20948_raw* raw)
+{
+	for(int i = 0; i < 3; i++)
+	{
+		raw->accel[i] = (int16_t)(data[2 * i] << 8 | data[2 * i + 1]);
+		raw->gyro[i] = (int16_t)(data[2 * i + 6] << 8 | data[2 * i + 7]);
+	}
+}
+
+void icm20948_convert(const icm20948_raw* raw, icm20948_sample* sample)
+{
+	sample->accel.x = raw->accel[0];
+	sample->accel.y = raw->accel[1];
+	sample->accel.z = raw->accel[2];
+	sample->gyro.x = raw->gyro[0];
+	sample->gyro.y = raw->gyro[1];
+	sample->gyro.z = raw->gyro[2];
+
+	sample->accel_g.x = sample->accel.x / accel_scale_factor;
+	sample->accel_g.y = sample->accel.y / accel_scale_factor;
+	sample->accel_g.z = sample->accel.z / accel_scale_factor;
+
+	sample->gyro_dps.x = sample->gyro.x / gyro_scale_factor;
+	sample->gyro_dps.y = sample->gyro.y / gyro_scale_factor;
+	sample->gyro_dps.z = sample->gyro.z / gyro_scale_factor;
+}
+
+void icm20948_data_ready_int_enable()
+{
+	// INT pin active high, push-pull, a 50 us pulse per sample (no latch, nothing to clear)
+	write_single_icm20948_reg(ub_0, B0_INT_PIN_CFG, 0x00);
+
+	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_INT_ENABLE_1);
+	new_val |= 0x01; // RAW_DATA_0_RDY_EN
+
+	write_single_icm20948_reg(ub_0, B0_INT_ENABLE_1, new_val);
+}
+
+void icm20948_data_ready_int_disable()
+{
+	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_INT_ENABLE_1);
+	new_val &= ~0x01;
+
+	write_single_icm20948_reg(ub_0, B0_INT_ENABLE_1, new_val);
+}
+
 bool icm20948_who_am_i()
 {
 	uint8_t icm20948_id = read_single_icm20948_reg(ub_0, B0_WHO_AM_I);
@@ -487,6 +702,7 @@ bool icm20948_who_am_i()
 void icm20948_device_reset()
 {
 	write_single_icm20948_reg(ub_0, B0_PWR_MGMT_1, 0x80 | 0x41);
+	user_bank = -1; // the reset sets bank 0, but select it again rather than rely on it
 	HAL_Delay(100);
 }
 
@@ -508,6 +724,110 @@ void icm20948_sleep()
 	HAL_Delay(100);
 }
 
+void icm20948_low_power_enable()
+{
+	// LP_CONFIG: accel, gyro and (unused) I2C master cycle at the ODR; PWR_MGMT_1: LP_EN
+	write_single_icm20948_reg(ub_0, B0_LP_CONFIG, 0x70);
+	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_PWR_MGMT_1);
+	new_val |= 0x20;
+
+	write_single_icm20948_reg(ub_0, B0_PWR_MGMT_1, new_val);
+}
+
+void icm20948_low_power_disable()
+{
+	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_PWR_MGMT_1);
+	new_val &= 0xDF;
+
+	write_single_icm20948_reg(ub_0, B0_PWR_MGMT_1, new_val);
+	write_single_icm20948_reg(ub_0, B0_LP_CONFIG, 0x40);
+}
+
+void icm20948_fifo_enable()
+{
+	// accel and gyro x, y, z, in the order of the output registers
+	write_single_icm20948_reg(ub_0, B0_FIFO_EN_2, 0x1E);
+	// snapshot: a full FIFO drops new samples instead of overwriting part of the oldest
+	write_single_icm20948_reg(ub_0, B0_FIFO_MODE, 0x1F);
+	icm20948_fifo_reset();
+
+	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_USER_CTRL);
+	new_val |= 0x40;
+
+	write_single_icm20948_reg(ub_0, B0_USER_CTRL, new_val);
+}
+
+void icm20948_fifo_disable()
+{
+	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_USER_CTRL);
+	new_val &= ~0x40;
+
+	write_single_icm20948_reg(ub_0, B0_USER_CTRL, new_val);
+	write_single_icm20948_reg(ub_0, B0_FIFO_EN_2, 0x00);
+}
+
+void icm20948_fifo_reset()
+{
+	write_single_icm20948_reg(ub_0, B0_FIFO_RST, 0x1F);
+	write_single_icm20948_reg(ub_0, B0_FIFO_RST, 0x00);
+}
+
+uint16_t icm20948_fifo_count()
+{
+	return icm20948_fifo_count_decode(read_multiple_icm20948_reg(ub_0, B0_FIFO_COUNTH, 2));
+}
+
+uint16_t icm20948_fifo_count_decode(const uint8_t* data)
+{
+	return (uint16_t)((data[0] & 0x1F) << 8 | data[1]);
+}
+
+int icm20948_fifo_read(icm20948_raw* raw, int max)
+{
+	uint8_t read_reg = READ | B0_FIFO_R_W;
+	uint8_t temp[ICM20948_FIFO_SAMPLE_LEN];
+	int n = icm20948_fifo_count() / ICM20948_FIFO_SAMPLE_LEN;
+
+	if(n > max)
+		n = max;
+	if(n == 0)
+		return 0;
+
+	select_user_bank(ub_0);
+
+	// one transfer: FIFO_R_W does not auto-increment, every byte read is the next one in the FIFO
+	cs_low();
+	HAL_SPI_Transmit(ICM20948_SPI, &read_reg, 1, 1000);
+	for(int i = 0; i < n; i++)
+	{
+		HAL_SPI_Receive(ICM20948_SPI, temp, ICM20948_FIFO_SAMPLE_LEN, 1000);
+		icm20948_decode_raw(temp, &raw[i]);
+	}
+	cs_high();
+
+	return n;
+}
+
+bool icm20948_read_dma(userbank ub, uint8_t reg, uint8_t* buf, uint16_t len)
+{
+	select_user_bank(ub); // nothing to send once the sensor is set up: only bank 0 is read then
+
+	// full duplex: the address goes out in buf[0] and the sensor ignores the bytes after it
+	buf[0] = READ | reg;
+	cs_low();
+	if(HAL_SPI_Receive_DMA(ICM20948_SPI, buf, len + 1) != HAL_OK)
+	{
+		cs_high();
+		return false;
+	}
+	return true;
+}
+
+void icm20948_read_dma_end()
+{
+	cs_high();
+}
+
 void icm20948_spi_slave_enable()
 {
 	uint8_t new_val = read_single_icm20948_reg(ub_0, B0_USER_CTRL);
@@ -552,8 +872,8 @@ void icm20948_gyro_sample_rate_divider(uint8_t divider)
 
 void icm20948_accel_sample_rate_divider(uint16_t divider)
 {
-	uint8_t divider_1 = (uint8_t)(divider >> 8);
-	uint8_t divider_2 = (uint8_t)(0x0F & divider);
+	uint8_t divider_1 = (uint8_t)((divider >> 8) & 0x0F); // ACCEL_SMPLRT_DIV_1 holds bits 11:8
+	uint8_t divider_2 = (uint8_t)(0xFF & divider);
 
 	write_single_icm20948_reg(ub_2, B2_ACCEL_SMPLRT_DIV_1, divider_1);
 	write_single_icm20948_reg(ub_2, B2_ACCEL_SMPLRT_DIV_2, divider_2);
@@ -718,12 +1038,17 @@ static void cs_low()
 static void select_user_bank(userbank ub)
 {
 	uint8_t write_reg[2];
+
+	if(ub == user_bank)
+		return;
+
 	write_reg[0] = WRITE | REG_BANK_SEL;
 	write_reg[1] = ub;
 
 	cs_low();
 	HAL_SPI_Transmit(ICM20948_SPI, write_reg, 2, 10);
 	cs_high();
+	user_bank = ub;
 }
 
 static uint8_t read_single_icm20948_reg(userbank ub, uint8_t reg)
@@ -756,7 +1081,7 @@ static void write_single_icm20948_reg(userbank ub, uint8_t reg, uint8_t val)
 static uint8_t* read_multiple_icm20948_reg(userbank ub, uint8_t reg, uint8_t len)
 {
 	uint8_t read_reg = READ | reg;
-	static uint8_t reg_val[6];
+	static uint8_t reg_val[12]; // up to the accel and gyro outputs
 	select_user_bank(ub);
 
 	cs_low();
@@ -777,6 +1102,80 @@ static void write_multiple_icm20948_reg(userbank ub, uint8_t reg, uint8_t* val,
 	HAL_SPI_Transmit(ICM20948_SPI, val, len, 1000);
 	cs_high();
 }
+/**
+ * The ICM-20948's data-ready interrupt (EXTI on ICM_INT_Pin): starts reading the new
+ * sample out of the FIFO by DMA, for the main loop to take from sampleRing whenever it is
+ * not busy compressing or sending.
+ */
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	if(GPIO_Pin != ICM_INT_Pin)
+		return;
+#if SHARC_POWER == SHARC_POWER_LOW
+	lastIntUs = sched_time_us() - intLateUs;
+	intLateUs = 0;
+	intSeen = 1;
+#endif
+	sensor_read_start();
+}
+
+/**
+ * Starts the DMA transfers that move the FIFO into sampleRing: its count, then the
+ * samples (HAL_SPI_RxCpltCallback() chains them). If a transfer is on its way already, or
+ * the DMA channel is lent to the UART, the samples wait in the FIFO and are read once the
+ * transfer is done or the channel is back. Runs at interrupt level, or with them held off.
+ */
+void sensor_read_start(void) {
+	if (sensorState != SENSOR_IDLE || !dma_ch4_take(DMA_CH4_SPI)) {
+		sensorReadPending = 1;
+		return;
+	}
+	sensorReadPending = 0;
+	sensorState = SENSOR_COUNT;
+	if (!icm20948_read_dma(ub_0, B0_FIFO_COUNTH, sensorDma, 2)) {
+		sensorState = SENSOR_IDLE;
+		dma_ch4_release();
+	}
+}
+
+/**
+ * A sensor transfer is in. After the count, reads up to SENSOR_BURST_MAX of the samples
+ * counted; after the samples, pushes them into sampleRing (a full ring drops them and
+ * counts them in sampleRing.dropped) and gives the DMA channel back.
+ */
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi) {
+	struct sample s;
+	int i, n;
+
+	if (hspi != ICM20948_SPI)
+		return;
+	icm20948_read_dma_end();
+	if (sensorState == SENSOR_COUNT) {
+		n = icm20948_fifo_count_decode(sensorDma + 1) / ICM20948_FIFO_SAMPLE_LEN;
+		if (n > SENSOR_BURST_MAX) {
+			n = SENSOR_BURST_MAX;
+			sensorReadPending = 1; // the rest follow in the next burst
+		}
+		if (n > 0 && icm20948_read_dma(ub_0, B0_FIFO_R_W, sensorDma, n * ICM20948_FIFO_SAMPLE_LEN)) {
+			sensorBurst = n;
+			sensorState = SENSOR_SAMPLES;
+			return;
+		}
+	} else {
+		// the last sample is the newest; the FIFO kept the others one ODR period apart
+		uint16_t tick = (uint16_t)HAL_GetTick();
+		for (i = 0; i < sensorBurst; i++) {
+			icm20948_decode_raw(sensorDma + 1 + i * ICM20948_FIFO_SAMPLE_LEN, &s.raw);
+			s.tick = tick - (uint16_t)((sensorBurst - 1 - i) * SAMPLE_PERIOD_US / 1000);
+			sample_ring_push(&sampleRing, &s);
+		}
+		if (!blockBusy && sample_ring_count(&sampleRing) >= SHARC_BLOCK_READINGS)
+			sched_ready(&sched, TASK_SAMPLING);
+	}
+	sensorState = SENSOR_IDLE;
+	dma_ch4_release();
+}
+
 /********************************
  * THIS IS THE COMPRESSION CODE
  *******************************/
@@ -852,14 +1251,14 @@ void output2(int x, int y)
     }
 }
 
-void compress(int encryptedData[], int encryptedBits)
+void compress(const uint8_t encryptedData[], int encryptedBits)
 {
     int i, j, f1, x, y, r, s, bufferend, c;
     int counter = 0;
 
     for (i = 0; i < N - F; i++) buffer[i] = ' ';
     for (i = N - F; i < N * 2; i++) {
-        if (counter > encryptedBits) break;
+        if (counter >= encryptedBits) break;
         c = encryptedData[counter];
         buffer[i] = c;  counter++;
         //printf("HERE2: %d\n",buffer[i]);
@@ -884,12 +1283,13 @@ void compress(int encryptedData[], int encryptedBits)
             for (i = 0; i < N; i++) buffer[i] = buffer[i + N];
             bufferend -= N;  r -= N;  s -= N;
             while (bufferend < N * 2) {
-                if (counter > encryptedBits) break;
+                if (counter >= encryptedBits) break;
                 c = encryptedData[counter];
                 buffer[bufferend++] = c;  counter++;
             }
         }
     }
+    flush_bit_buffer();
     /*
     // Can be used to check that compression is working at this point
     int count = 0;
@@ -918,10 +1318,13 @@ void compress(int encryptedData[], int encryptedBits)
         return result;
 }
 
-void encrypt(char msg[]) {
+/**
+ * RSA encrypts the block byte by byte into encryptedData, for compress().
+ */
+void rsa_encrypt(char msg[], int len) {
     int c;
 	int i;
-        for (i = 0; msg[i]!= '}'; i++)
+        for (i = 0; i < len; i++)
         {
             c = ENCmodpow(msg[i],e,n);
             encryptedData[i] = c;
@@ -933,8 +1336,598 @@ void encrypt(char msg[]) {
                 HAL_UART_Transmit(&huart2, mesg, sizeof(mesg), 1000);
             }*/
         }
-        //call compression
-        compress(encryptedData, encryptedBits);
+}
+
+void encrypt(char msg[], int len) {
+	rsa_encrypt(msg, len);
+	//call compression
+	compress(encryptedData, encryptedBits);
+}
+
+/**
+ * Clears the compression and encryption state so that every block is compressed
+ * (and decompressed on the ground) independently of the previous one.
+ */
+void reset_block(void) {
+	bit_buffer = 0;
+	bit_mask = 128;
+	compressedBits = 0;
+	encryptedBits = 0;
+}
+
+/********************************
+ * THIS IS THE AEAD CODE
+ *******************************/
+// the boot log: the last two 1 KB pages of the flash, which STM32F051R8TX_FLASH.ld leaves out of FLASH
+#define BOOT_LOG_ADDR 0x0800F800U
+#define BOOT_LOG_WORDS (FLASH_PAGE_SIZE / 4) // per page
+#define BOOT_LOG_ERASED 0xFFFFFFFFU
+
+/**
+ * Takes the next boot number, one more than the highest in the boot log, and writes it to
+ * the log before it is used. The log is two flash pages filled a word at a time; when the
+ * page of the highest number is full, the other page, which only holds older numbers, is
+ * erased and the number starts it, so a reset in the middle of an erase loses nothing.
+ * Returns 0 if the number could not be written, as it would then come again after a reset.
+ */
+int boot_next(uint32_t *boot) {
+	const volatile uint32_t *log = (const volatile uint32_t *)BOOT_LOG_ADDR;
+	FLASH_EraseInitTypeDef erase;
+	uint32_t last = 0, pageError;
+	int i, at = -1, slot, ok = 1;
+
+	for (i = 0; i < 2 * BOOT_LOG_WORDS; i++) {
+		// a word cut off by a reset while it was programmed reads as a number too: a higher one
+		// only makes the next number higher
+		if (log[i] != BOOT_LOG_ERASED && (at < 0 || log[i] > last)) {
+			last = log[i];
+			at = i;
+		}
+	}
+	*boot = at < 0 ? 0 : last + 1;
+	if (*boot == BOOT_LOG_ERASED) {
+		return 0; // every number has been used
+	}
+	slot = (at + 1) % (2 * BOOT_LOG_WORDS);
+	HAL_FLASH_Unlock();
+	if (slot % BOOT_LOG_WORDS == 0 || log[slot] != BOOT_LOG_ERASED) {
+		slot = at < BOOT_LOG_WORDS ? BOOT_LOG_WORDS : 0; // the start of the other page
+		erase.TypeErase = FLASH_TYPEERASE_PAGES;
+		erase.PageAddress = BOOT_LOG_ADDR + slot * 4;
+		erase.NbPages = 1;
+		ok = HAL_FLASHEx_Erase(&erase, &pageError) == HAL_OK;
+	}
+	ok = ok && HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, BOOT_LOG_ADDR + slot * 4, *boot) == HAL_OK;
+	HAL_FLASH_Lock();
+	return ok && log[slot] == *boot;
+}
+
+/**
+ * Keys the suite and starts the nonces of this boot at block 0 of the next boot number.
+ * The keys are the same after every reset, so the nonces must not be: with the block
+ * number alone, every reset would encrypt with the keystream (and Poly1305 key) of the
+ * blocks sent after the previous one.
+ */
+void aead_init(void) {
+	uint32_t boot;
+
+	if (!boot_next(&boot)) {
+		Error_Handler();
+	}
+	seqnr = (uint64_t)boot << 32;
+#if SHARC_CIPHER == SHARC_CIPHER_ASCON
+	if (ascon128_init(&ascon_ctx, aead_k_1, ASCON128_KEY_LEN) != 0) {
+		Error_Handler();
+	}
+#elif SHARC_CIPHER == SHARC_CIPHER_SIPHASH
+	if (siphash24_mac_init(&siphash_ctx, aead_k_2, SIPHASH_KEY_LEN) != 0) {
+		Error_Handler();
+	}
+#else
+	if (chacha20poly1305_init(&aead_ctx, aead_k_1, sizeof(aead_k_1), aead_k_2, sizeof(aead_k_2)) != 0 ||
+			chacha20poly1305_set_rounds(&aead_ctx, SHARC_CHACHA_ROUNDS) != 0) {
+		Error_Handler();
+	}
+#endif
+}
+
+/**
+ * Stages the plaintext block in encryptedData, the array the RSA path uses, for compress().
+ */
+void aead_stage(const uint8_t msg[], int len) {
+	int i;
+	for (i = 0; i < len; i++) {
+		encryptedData[i] = msg[i];
+		encryptedBits++;
+	}
+}
+
+/**
+ * Seals the compressed block as one frame:
+ * [suite][8 byte nonce][3 byte encrypted length][encrypted compressed bytes][16 byte tag]
+ * The suite byte is the ChaCha rounds for ChaCha20-Poly1305, ASCON128_FRAME_SUITE for Ascon-128
+ * and SIPHASH_FRAME_SUITE for the MAC-only frame, which is not encrypted and has an 8 byte tag.
+ * The nonce (seqnr, little-endian) is sent in the clear for the ground station to open the
+ * frame with; it is covered by the tag as the nonce, and the ground station should only
+ * take increasing nonces within a boot number, which rejects replayed frames.
+ * The frame is built and encrypted in place in sealedData.
+ */
+void aead_seal(void) {
+	uint8_t *frame = sealedData + 1 + FRAME_SEALED_NONCE_LEN; // after the suite byte and the nonce
+	int i, taglen;
+
+	for (i = 0; i < FRAME_SEALED_NONCE_LEN; i++) {
+		sealedData[1 + i] = (seqnr >> (8 * i)) & 0xFF;
+	}
+	frame[0] = compressedBits & 0xFF;
+	frame[1] = (compressedBits >> 8) & 0xFF;
+	frame[2] = (compressedBits >> 16) & 0xFF;
+	for (i = 0; i < compressedBits; i++) {
+		frame[CHACHA20_POLY1305_AEAD_AAD_LEN + i] = (uint8_t)compressed[i];
+	}
+#if SHARC_CIPHER == SHARC_CIPHER_ASCON
+	sealedData[0] = ASCON128_FRAME_SUITE;
+	taglen = ASCON128_TAGLEN;
+	if (ascon128_crypt(&ascon_ctx, seqnr, frame, sizeof(sealedData) - 1 - FRAME_SEALED_NONCE_LEN, frame,
+			ASCON128_AAD_LEN + compressedBits, 1) != 0) {
+		Error_Handler();
+	}
+#elif SHARC_CIPHER == SHARC_CIPHER_SIPHASH
+	sealedData[0] = SIPHASH_FRAME_SUITE;
+	taglen = SIPHASH_TAGLEN;
+	if (siphash24_mac_crypt(&siphash_ctx, seqnr, frame, sizeof(sealedData) - 1 - FRAME_SEALED_NONCE_LEN, frame,
+			SIPHASH_AAD_LEN + compressedBits, 1) != 0) {
+		Error_Handler();
+	}
+#else
+	sealedData[0] = SHARC_CHACHA_ROUNDS;
+	taglen = POLY1305_TAGLEN;
+	if (chacha20poly1305_crypt(&aead_ctx, seqnr, seqnr / AAD_PACKAGES_PER_ROUND,
+			(seqnr % AAD_PACKAGES_PER_ROUND) * CHACHA20_POLY1305_AEAD_AAD_LEN, frame,
+			sizeof(sealedData) - 1 - FRAME_SEALED_NONCE_LEN, frame,
+			CHACHA20_POLY1305_AEAD_AAD_LEN + compressedBits, 1) != 0) {
+		Error_Handler();
+	}
+#endif
+	sealedBytes = 1 + FRAME_SEALED_NONCE_LEN + CHACHA20_POLY1305_AEAD_AAD_LEN + compressedBits + taglen;
+	seqnr++;
+	if ((uint32_t)seqnr == 0) {
+		// 2^32 blocks in one boot: the block number would carry into the boot number
+		aead_init();
+	}
+}
+
+/**
+ * Compresses the block and then seals the compressed bytes (aead_seal()).
+ */
+void seal(const uint8_t msg[], int len) {
+	aead_stage(msg, len);
+	compress(encryptedData, encryptedBits);
+	aead_seal();
+}
+
+/**
+ * Writes v at p as "%.2f" would, and returns the end of the text. The float is taken apart
+ * into its 24 bit mantissa and its exponent, and its exact value is rounded to hundredths
+ * in integers (half to even, like printf). The digits come from subtracting powers of ten,
+ * as the Cortex-M0 has no divide instruction. Values of 2^23 and more (no reading comes
+ * near them) are left to sprintf().
+ */
+char *put_hundredths(char *p, float v) {
+	static const uint32_t pow10[] = { 1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1 };
+	uint32_t bits, m, h, rem, half;
+	int exponent, shift, i, lead = 0;
+
+	memcpy(&bits, &v, sizeof(bits));
+	exponent = (bits >> 23) & 0xFF;
+	if (exponent >= 150) return p + sprintf(p, "%.2f", v); // also inf and nan
+	if (bits >> 31) *p++ = '-'; // -0.00 too, as printf writes it
+	m = bits & 0x7FFFFF;
+	if (exponent != 0) m |= 0x800000;
+	else exponent = 1; // subnormal
+	m *= 100; // < 2^31
+	shift = 150 - exponent; // v * 100 = m * 2^-shift
+	if (shift >= 32) {
+		h = 0; // less than a half
+	} else {
+		h = m >> shift;
+		rem = m & ((1u << shift) - 1);
+		half = 1u << (shift - 1);
+		if (rem > half || (rem == half && (h & 1))) h++;
+	}
+	for (i = 0; i < 10; i++) {
+		char d = '0';
+		while (h >= pow10[i]) {
+			h -= pow10[i];
+			d++;
+		}
+		if (d != '0' || i >= 7) lead = 1; // the units digit always
+		if (lead) *p++ = d;
+		if (i == 7) *p++ = '.';
+	}
+	return p;
+}
+
+/**
+ * Formats one reading as a text record (SHARC_RECORD_TEXT) at dest:
+ * "\r\n%.2f,%.2f,%.2f,%.2f,%.2f,%.2f;" of the sample in g and dps, without the
+ * terminator. Returns the record length, at most SHARC_READING_TEXT_MAX.
+ */
+int format_record(char *dest, const icm20948_sample *s) {
+	char *p = dest;
+	*p++ = '\r';
+	*p++ = '\n';
+	p = put_hundredths(p, s->accel_g.x);
+	*p++ = ',';
+	p = put_hundredths(p, s->accel_g.y);
+	*p++ = ',';
+	p = put_hundredths(p, s->accel_g.z);
+	*p++ = ',';
+	p = put_hundredths(p, s->gyro_dps.x);
+	*p++ = ',';
+	p = put_hundredths(p, s->gyro_dps.y);
+	*p++ = ',';
+	p = put_hundredths(p, s->gyro_dps.z);
+	*p++ = ';';
+	return p - dest;
+}
+
+/**
+ * Packs one reading as a binary record (SHARC_RECORD_BINARY): the raw accelerometer and
+ * gyroscope counts of the sample as little-endian int16, then with SHARC_RECORD_TIMESTAMP
+ * the milliseconds between the sample and the previous one, from the ticks the
+ * data-ready interrupt took them at. The ground divides the counts by the scale factors
+ * in the header, so the readings come out exactly as the text records would have them.
+ * Returns the record length.
+ */
+int pack_record(uint8_t *dest, const struct sample *s) {
+	int i;
+	for (i = 0; i < 3; i++) {
+		dest[2 * i] = (uint16_t)s->raw.accel[i] & 0xFF;
+		dest[2 * i + 1] = (uint16_t)s->raw.accel[i] >> 8;
+		dest[2 * i + 6] = (uint16_t)s->raw.gyro[i] & 0xFF;
+		dest[2 * i + 7] = (uint16_t)s->raw.gyro[i] >> 8;
+	}
+#if SHARC_RECORD_TIMESTAMP
+	static uint16_t last;
+	uint16_t dt = s->tick - last; // samples are far less than 65 s apart
+	last = s->tick;
+	dest[12] = dt & 0xFF;
+	dest[13] = dt >> 8;
+#endif
+	return SHARC_RECORD_LEN;
+}
+
+/********************************
+ * THIS IS THE LINK CODE
+ *******************************/
+/**
+ * Lends DMA1 channel 4 to the SPI (DMA_CH4_SPI) or the UART (DMA_CH4_UART), set up for
+ * it, if no one has it. Returns 0 if it is taken. Runs at interrupt level, or with them
+ * held off, like dma_ch4_release().
+ */
+int dma_ch4_take(uint8_t owner) {
+	if (dmaCh4Owner != DMA_CH4_FREE)
+		return 0;
+	dmaCh4Owner = owner;
+	// the channel keeps the direction of the handle initialised on it last
+	HAL_DMA_Init(owner == DMA_CH4_SPI ? &hdma_spi2_rx : &hdma_usart2_tx);
+	return 1;
+}
+
+/**
+ * Gives DMA1 channel 4 back, and lends it to whoever waited: a sensor read first, as it
+ * takes some hundred microseconds where a frame takes up to half a second.
+ */
+void dma_ch4_release(void) {
+	dmaCh4Owner = DMA_CH4_FREE;
+	if (sensorReadPending)
+		sensor_read_start();
+	if (dmaCh4Owner == DMA_CH4_FREE && !txRetry)
+		tx_start();
+}
+
+/**
+ * Returns the txFrame buffer to encode the next frame into, once it is free. The buffers
+ * are used in turn, so this only waits if both frames before are still on the air.
+ */
+int tx_acquire(void) {
+	int i = txNext;
+	if (txBusy[i]) {
+		txWaits++;
+		while (txBusy[i]) {
+			tx_retry();
+			__WFI(); // until its transmit completes
+		}
+	}
+	txNext ^= 1;
+	return i;
+}
+
+/**
+ * Starts sending the older frame waiting in txFrame, if the UART is idle and gets the DMA
+ * channel; otherwise it is started when the frame on the air is done, or the channel is
+ * given back. If the UART does not take it (HAL_BUSY, HAL_ERROR), the channel goes back
+ * to the SPI at once and the frame waits in its buffer for tx_retry(). Runs at interrupt
+ * level, or with them held off.
+ */
+void tx_start(void) {
+	int i = txBusy[txNext] ? txNext : txNext ^ 1; // the buffers are filled in turn
+	if (txActive >= 0 || !txBusy[i] || !dma_ch4_take(DMA_CH4_UART))
+		return;
+	txActive = i;
+	if (HAL_UART_Transmit_DMA(&huart2, txFrame[i], txLen[i]) != HAL_OK) {
+		txActive = -1;
+		txRetry = 1; // not from dma_ch4_release(), which would try again at once
+		txRetries++;
+		dma_ch4_release();
+	}
+}
+
+/**
+ * Starts the frame the UART did not take (tx_start()) again. Called from the main loop:
+ * by housekeeping, and while tx_acquire() waits for its buffer.
+ */
+void tx_retry(void) {
+	if (!txRetry)
+		return;
+	__disable_irq();
+	txRetry = 0;
+	tx_start();
+	__enable_irq();
+}
+
+/**
+ * Sends the size bytes encoded in txFrame[i] by DMA, as soon as the frame before it is
+ * done (tx_start()). Returns at once.
+ */
+void tx_submit(int i, size_t size) {
+	txLen[i] = size;
+	txBusy[i] = 1;
+	__disable_irq();
+	tx_start();
+	__enable_irq();
+}
+
+/**
+ * The UART has sent the last byte of txFrame[txActive]: frees it and the DMA channel,
+ * which goes to a sensor read that waited for it, or the next frame.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+	txBusy[txActive] = 0;
+	txActive = -1;
+	dma_ch4_release();
+}
+
+/**
+ * Sends one binary frame (frame.h) on the UART. The payload is copied into a txFrame
+ * buffer, so the caller can reuse it as soon as this returns, while the frame is sent.
+ */
+void send_frame(uint8_t type, uint16_t seq, const uint8_t *payload, int len) {
+	int i = tx_acquire();
+	tx_submit(i, frame_encode(txFrame[i], type, seq, payload, len));
+}
+
+/**
+ * Sends cpuLoad, cpuLoadMax and every task's figures (schedStats) as a status frame
+ * (FRAME_TYPE_STATUS in frame.h). Returns 0 without sending if the next frame buffer is
+ * still busy: housekeeping does not wait for it, it tries again a period later.
+ */
+int send_status(void) {
+	struct frame_writer w;
+	int i, buf;
+
+	if (txBusy[txNext])
+		return 0;
+	buf = tx_acquire();
+	frame_begin(&w, txFrame[buf], FRAME_TYPE_STATUS, statusSeq++, FRAME_STATUS_LEN(TASKS));
+	frame_put_le(&w, cpuLoad, 2);
+	frame_put_le(&w, cpuLoadMax, 2);
+	frame_put_le(&w, TASKS, 1);
+	for (i = 0; i < TASKS; i++) {
+		frame_put_le(&w, schedStats[i].runs, 4);
+		frame_put_le(&w, schedStats[i].busy_us, 4);
+		frame_put_le(&w, schedStats[i].max_run_us, 4);
+		frame_put_le(&w, schedStats[i].max_latency_us, 4);
+		frame_put_le(&w, schedStats[i].misses, 2);
+	}
+	tx_submit(buf, frame_end(&w));
+	return 1;
+}
+
+/**
+ * Sends the code of the block just encrypted and compressed (encrypt()) or sealed (seal()).
+ */
+void send_code_frame(uint16_t seq) {
+#if SHARC_CIPHER != SHARC_CIPHER_RSA
+	send_frame(FRAME_TYPE_SEALED, seq, sealedData, sealedBytes);
+#else
+	struct frame_writer w;
+	int i, buf = tx_acquire();
+	frame_begin(&w, txFrame[buf], FRAME_TYPE_RSA, seq, compressedBits);
+	for (i = 0; i < compressedBits; i++) {
+		frame_put(&w, (uint8_t)compressed[i]);
+	}
+	tx_submit(buf, frame_end(&w));
+#endif
+}
+
+/********************************
+ * THIS IS THE POWER CODE
+ *******************************/
+/**
+ * Sleeps until the next interrupt. With SHARC_POWER_LOW and no transfer on its way by DMA,
+ * which STOP would halt, the MCU stops instead: its clocks and SysTick stand still and only
+ * the sensor's data-ready EXTI wakes it, one ODR period after the last. SYSCLK is the HSI,
+ * which STOP wakes up on, so nothing needs setting up again. HAL_GetTick() is then set
+ * forward by the time stopped, to the interrupt plus STOP_WAKEUP_US, so the sample
+ * timestamps and the scheduler's clock go on as if SysTick had run.
+ */
+void power_idle(void) {
+#if SHARC_POWER == SHARC_POWER_LOW
+	__disable_irq(); // an interrupt now still wakes STOP, but its handler waits for the tick
+	if (intSeen && !sched_busy(&sched) && dmaCh4Owner == DMA_CH4_FREE && sensorState == SENSOR_IDLE &&
+			!sensorReadPending && !txBusy[0] && !txBusy[1]) {
+		uint32_t entry = sched_time_us();
+		int32_t stopped;
+
+		HAL_SuspendTick();
+		HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+		HAL_ResumeTick();
+		stopped = (int32_t)(lastIntUs + SAMPLE_PERIOD_US + STOP_WAKEUP_US - entry);
+		// woken by the sensor, after the ODR period; anything else was pending at once
+		if (__HAL_GPIO_EXTI_GET_IT(ICM_INT_Pin) && stopped > 0) {
+			stopCarryUs += stopped;
+			uwTick += stopCarryUs / 1000;
+			stopCarryUs %= 1000;
+			intLateUs = STOP_WAKEUP_US;
+		}
+		__enable_irq();
+		return;
+	}
+	__enable_irq();
+#endif
+	__WFI();
+}
+
+/********************************
+ * THIS IS THE TASK CODE
+ *******************************/
+/**
+ * Takes the block of readings waiting in sampleRing out and formats it into the block,
+ * as text or binary records, then hands it on: to compression, or to crypto with RSA,
+ * which encrypts before it compresses. Made ready by the data-ready interrupt, or by
+ * transmission, once a block is in and the one before has gone.
+ */
+void task_sampling(void *ctx) {
+	struct block *b = ctx;
+	blockBusy = 1;
+	for (int i = 0; i < SHARC_BLOCK_READINGS; i++) {
+		const struct sample *reading_sample = sample_ring_peek(&sampleRing, i);
+#if SHARC_RECORD == SHARC_RECORD_BINARY
+		// raw data only, the ground converts it
+		b->len += pack_record((uint8_t*)b->inputArray + b->len, reading_sample);
+#else
+		// raw data and unit conversion, of the same sample
+		icm20948_sample my_sample;
+		icm20948_convert(&reading_sample->raw, &my_sample);
+
+		/*
+		 * If any changes are made to the formatting of the readings (format_record()),
+		 * SHARC_READING_TEXT_MAX (sharc_config.h) needs to be updated: it sizes inputArray[].
+		 */
+		b->len += format_record(b->inputArray + b->len, &my_sample);
+#endif
+	}
+	// the samples are in the block now: their slots can take block k + 2
+	sample_ring_release(&sampleRing, SHARC_BLOCK_READINGS);
+#if SHARC_RECORD != SHARC_RECORD_BINARY
+	b->inputArray[b->len] = '}';
+	b->inputArray[b->len + 1] = '\0';
+#endif
+	reset_block();
+	sched_ready(&sched, SHARC_CIPHER != SHARC_CIPHER_RSA ? TASK_COMPRESSION : TASK_CRYPTO);
+}
+
+/**
+ * LZSS compresses the plaintext block for the AEAD ciphers, the RSA code for RSA.
+ */
+void task_compression(void *ctx) {
+	struct block *b = ctx;
+#if SHARC_CIPHER != SHARC_CIPHER_RSA
+	aead_stage((uint8_t*)b->inputArray, b->len);
+	compress(encryptedData, encryptedBits);
+	sched_ready(&sched, TASK_CRYPTO);
+#else
+	(void)b;
+	compress(encryptedData, encryptedBits);
+	sched_ready(&sched, TASK_TRANSMISSION);
+#endif
+}
+
+/**
+ * Seals the compressed block (aead_seal()), or RSA encrypts the plaintext block.
+ */
+void task_crypto(void *ctx) {
+	struct block *b = ctx;
+#if SHARC_CIPHER != SHARC_CIPHER_RSA
+	(void)b;
+	aead_seal();
+	sched_ready(&sched, TASK_TRANSMISSION);
+#else
+	rsa_encrypt(b->inputArray, b->len);
+	sched_ready(&sched, TASK_COMPRESSION);
+#endif
+}
+
+/**
+ * Sends the readings of the block and then its code, and frees the block for the next
+ * one, which sampling takes at once if it is in already.
+ */
+void task_transmission(void *ctx) {
+	struct block *b = ctx;
+#if SHARC_RECORD == SHARC_RECORD_BINARY
+	send_frame(FRAME_TYPE_RECORDS, b->seq, (uint8_t*)b->inputArray, b->len);
+#elif SHARC_LINK == SHARC_LINK_FRAMES
+	send_frame(FRAME_TYPE_READINGS, b->seq, (uint8_t*)b->inputArray, b->len); // without the '}'
+#else
+	HAL_UART_Transmit(&huart2, (uint8_t*)b->inputArray, b->len + 1, 1000); // up to the '}'
+#endif
+
+#if SHARC_LINK == SHARC_LINK_FRAMES
+	send_code_frame(b->seq);
+#else
+	char start[4];
+	sprintf(start, "\r\n#");
+	HAL_UART_Transmit(&huart2, (uint8_t*)start, sizeof(start), 1000);
+
+#if SHARC_CIPHER != SHARC_CIPHER_RSA
+	int count = 0;
+	while (count < sealedBytes) {
+		char temp [7];
+		sprintf(temp, "\r\n%d,",sealedData[count]); // see the formatting note below
+		HAL_UART_Transmit(&huart2, (uint8_t*)temp, sizeof(temp), 1000);
+		count++;
+	}
+#else
+	int count = 0;
+	while (count < compressedBits) {
+		char temp [8]; // "\r\n-128," and its terminator
+		/*
+		 * note that the numbers are of different lengths and so this causes extra blank space in the formatting
+		 * which the transmission will fill with random characters. Make sure to used clean.py or adapt it to remove
+		 * the unwanted characters.
+		 */
+		sprintf(temp, "\r\n%d,",compressed[count]);
+		HAL_UART_Transmit(&huart2, (uint8_t*)temp, 7, 1000);
+		count++;
+	}
+#endif
+#endif
+	b->seq++;
+	/** Reset the values for the next block **/
+	b->len = 0; // the next block is written over this one
+	blockBusy = 0;
+	if (sample_ring_count(&sampleRing) >= SHARC_BLOCK_READINGS)
+		sched_ready(&sched, TASK_SAMPLING); // it came in while this block was on its way
+}
+
+/**
+ * Every HOUSEKEEPING_PERIOD_MS: the CPU load over the period, from the tasks' run times,
+ * and a frame the UART did not take is started again. On the frames link the load and the
+ * tasks' figures go to the ground every SHARC_STATUS_PERIOD_S (send_status()).
+ */
+void task_housekeeping(void *ctx) {
+	(void)ctx;
+	cpuLoad = sched_load(&sched);
+	if (cpuLoad > cpuLoadMax)
+		cpuLoadMax = cpuLoad;
+	tx_retry();
+#if SHARC_LINK == SHARC_LINK_FRAMES && SHARC_STATUS_PERIOD_S > 0
+	static uint16_t statusAge; // housekeeping periods since the last status frame
+	if (++statusAge >= SHARC_STATUS_PERIOD_S * 1000 / HOUSEKEEPING_PERIOD_MS && send_status())
+		statusAge = 0;
+#endif
 }
 
 /* USER CODE END 4 */
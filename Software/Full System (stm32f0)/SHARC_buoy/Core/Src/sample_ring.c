@@ -0,0 +1,48 @@
+/*
+ * Single-producer, single-consumer sample ring (see sample_ring.h). The Cortex-M0 has
+ * one core and does not reorder its memory accesses, so keeping the compiler from moving
+ * the slot copy past the index update is all the ordering needed.
+ */
+
+#include "sample_ring.h"
+
+#define barrier() __asm volatile("" ::: "memory")
+
+void sample_ring_init(struct sample_ring* r)
+{
+    r->head = r->tail = 0;
+    r->dropped = 0;
+}
+
+int sample_ring_push(struct sample_ring* r, const struct sample* s)
+{
+    uint16_t head = r->head;
+
+    if ((uint16_t)(head - r->tail) == SAMPLE_RING_LEN) {
+        r->dropped++;
+        return 0;
+    }
+    r->buf[head % SAMPLE_RING_LEN] = *s;
+    barrier();
+    r->head = head + 1;
+    return 1;
+}
+
+const struct sample* sample_ring_peek(const struct sample_ring* r, int i)
+{
+    const struct sample* s = &r->buf[(uint16_t)(r->tail + i) % SAMPLE_RING_LEN];
+
+    barrier(); /* the slot is read after the head that covers it */
+    return s;
+}
+
+void sample_ring_release(struct sample_ring* r, int n)
+{
+    barrier(); /* done with the slots before handing them back */
+    r->tail = r->tail + n;
+}
+
+int sample_ring_count(const struct sample_ring* r)
+{
+    return (uint16_t)(r->head - r->tail);
+}
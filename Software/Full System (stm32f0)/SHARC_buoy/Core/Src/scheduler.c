@@ -0,0 +1,138 @@
+/*
+ * Cooperative scheduler (see scheduler.h). Interrupt handlers only ever set a task's ready
+ * flag, after its ready time; the main loop clears it, with interrupts held off so that a
+ * sched_ready() in between is not lost.
+ */
+
+#include "scheduler.h"
+#include "main.h"
+
+#define barrier() __asm volatile("" ::: "memory")
+#define NO_DEADLINE INT32_MAX
+
+void sched_init(struct sched* s, const struct sched_task* tasks, struct sched_stats* stats, int n, void* ctx)
+{
+    int i;
+
+    s->tasks = tasks;
+    s->stats = stats;
+    s->n = n;
+    s->ctx = ctx;
+    s->load_us = sched_time_us();
+    s->load_busy_us = 0;
+    for (i = 0; i < n; i++) {
+        stats[i] = (struct sched_stats){ 0 };
+        stats[i].ready_us = s->load_us; /* a periodic task is first due a period from now */
+    }
+}
+
+void sched_ready(struct sched* s, int id)
+{
+    struct sched_stats* st = &s->stats[id];
+
+    if (st->ready)
+        return; /* its latency counts from the first time */
+    st->ready_us = sched_time_us();
+    barrier();
+    st->ready = 1;
+}
+
+/* microseconds left until the deadline of the ready task i, negative once it is past */
+static int32_t slack(const struct sched* s, int i, uint32_t now)
+{
+    const struct sched_task* t = &s->tasks[i];
+
+    if (t->deadline_ms == 0)
+        return NO_DEADLINE;
+    return (int32_t)(s->stats[i].ready_us + t->deadline_ms * 1000UL - now);
+}
+
+int sched_run(struct sched* s)
+{
+    uint32_t now = sched_time_us(), start, end, run_us, latency_us, ready_us;
+    int i, next = -1;
+    int32_t best = 0, d;
+    struct sched_stats* st;
+
+    __disable_irq();
+    for (i = 0; i < s->n; i++) {
+        st = &s->stats[i];
+        if (!st->ready && s->tasks[i].period_ms != 0 && now - st->ready_us >= s->tasks[i].period_ms * 1000UL) {
+            st->ready_us += s->tasks[i].period_ms * 1000UL; /* due at the period, not when noticed */
+            st->ready = 1;
+        }
+        if (st->ready && ((d = slack(s, i, now)) < best || next < 0)) {
+            best = d;
+            next = i;
+        }
+    }
+    if (next < 0) {
+        __enable_irq();
+        return 0;
+    }
+    st = &s->stats[next];
+    ready_us = st->ready_us;
+    st->ready = 0; /* the task may make itself ready again */
+    __enable_irq();
+
+    start = sched_time_us();
+#ifdef SCHED_RUN_HOOK
+    SCHED_RUN_HOOK(next, s->ctx); /* the host build charges the task's modelled run time here */
+#endif
+    s->tasks[next].run(s->ctx);
+    end = sched_time_us();
+
+    run_us = end - start;
+    latency_us = end - ready_us;
+    st->runs++;
+    st->busy_us += run_us;
+    if (run_us > st->max_run_us)
+        st->max_run_us = run_us;
+    if (latency_us > st->max_latency_us)
+        st->max_latency_us = latency_us;
+    if (s->tasks[next].deadline_ms != 0 && latency_us > s->tasks[next].deadline_ms * 1000UL)
+        st->misses++;
+    return 1;
+}
+
+int sched_busy(const struct sched* s)
+{
+    int i;
+
+    for (i = 0; i < s->n; i++)
+        if (s->stats[i].ready)
+            return 1;
+    return 0;
+}
+
+uint16_t sched_load(struct sched* s)
+{
+    uint32_t now = sched_time_us(), busy = 0, elapsed = now - s->load_us, load;
+    int i;
+
+    for (i = 0; i < s->n; i++)
+        busy += s->stats[i].busy_us;
+    load = elapsed == 0 ? 0 : (uint32_t)((uint64_t)(busy - s->load_busy_us) * 1000 / elapsed);
+    s->load_us = now;
+    s->load_busy_us = busy;
+    return load;
+}
+
+/*
+ * SysTick counts down from LOAD to 0 once a millisecond, when HAL_GetTick() goes up. An
+ * interrupt handler that holds off SysTick's (the lowest priority) sees the millisecond
+ * pending instead.
+ */
+uint32_t sched_time_us(void)
+{
+    uint32_t ms, val, pending;
+
+    do {
+        ms = HAL_GetTick();
+        val = SysTick->VAL;
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+    } while (ms != HAL_GetTick()); /* SysTick wrapped in between */
+    if (pending && val > SysTick->LOAD / 2)
+        ms++; /* it wrapped, and its interrupt has not run yet */
+    return ms * 1000 + (SysTick->LOAD - val) * 1000 / (SysTick->LOAD + 1);
+}
@@ -0,0 +1,38 @@
+/*
+ * ground.h
+ *
+ * The receiving end of the SHARC_buoy block pipelines, for the host tools: undoes the
+ * firmware's LZSS (SHARC_LZSS_EI and SHARC_LZSS_EJ) and RSA (d = 107, n = 187) and opens sealed frames
+ * with the ground station's copy of the buoy keys.
+ */
+
+#ifndef __GROUND_H
+#define __GROUND_H
+
+#include <stdint.h>
+
+void ground_init(void);
+
+/* LZSS decoder for the firmware's EI/EJ. Returns the text length, -1 if out is too small */
+int ground_decompress(const uint8_t *in, int inlen, char *out, int outmax);
+
+/* the RSA path (encrypt() in main.c): decompresses the code and decrypts every byte */
+int ground_rsa_open(const uint8_t *code, int codelen, char *text, int textmax);
+
+/*
+ * the AEAD path (seal() in main.c): opens the frame [suite][nonce][length][data][tag] with
+ * the suite and the nonce it carries and decompresses it. The nonce is stored in *nonce;
+ * the caller checks it is one it has not taken before.
+ * Returns the text length, -1 if the frame does not open.
+ */
+int ground_open_frame(const uint8_t *frame, int framelen, uint64_t *nonce, char *text, int textmax);
+
+/*
+ * the readings of a SHARC_RECORD_BINARY block as the "\r\n%.2f,...;" text main.c makes
+ * with SHARC_RECORD_TEXT, using the counts per g and per dps
+ * from the header. Returns the text length, -1 if text is too small.
+ */
+int ground_records_to_text(const uint8_t *records, int len, int record_len, float accel_scale, float gyro_scale,
+		char *text, int textmax);
+
+#endif /* __GROUND_H */
@@ -0,0 +1,51 @@
+/*
+ * hal_stub.h
+ *
+ * Hooks into the host HAL stub (hal_stub.c) used by the host-side tools.
+ */
+
+#ifndef __HAL_STUB_H
+#define __HAL_STUB_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HAL_SPI_HZ 4000000	// SPI2: 8 MHz HSI with SPI_BAUDRATEPRESCALER_2
+
+extern unsigned long hal_uart_bytes;	// bytes passed to HAL_UART_Transmit(_DMA)
+extern FILE *hal_uart_capture;			// if set, every transmitted byte is also written here
+// if set, called when a HAL_UART_Transmit(_DMA) starts, and when its last byte has left
+extern void (*hal_uart_tx_start_hook)(const uint8_t *data, uint16_t size);
+extern void (*hal_uart_tx_hook)(const uint8_t *data, uint16_t size);
+
+// UART overlap: the time bytes were on the air, and the part of it the CPU spent
+// waiting in a blocking HAL_UART_Transmit; a DMA transmit leaves the CPU free
+extern uint64_t hal_uart_busy_us;
+extern uint64_t hal_uart_blocked_us;
+int hal_uart_sending(void);				// 1 while bytes are on the air
+
+// the same for the SPI: its time on the wire, and the part the CPU waited in a blocking transfer
+extern uint64_t hal_spi_busy_us;
+extern uint64_t hal_spi_blocked_us;
+// DMA transfers started on DMA1 channel 4 while it was in use by the other of SPI2_RX and USART2_TX
+extern unsigned long hal_dma_conflicts;
+// if set, every n-th HAL_UART_Transmit_DMA() fails with HAL_ERROR, as a DMA start error would
+extern unsigned long hal_uart_dma_fail_every;
+
+// time in the MCU's low-power modes: sleep (__WFI()) and STOP; it runs the rest of the time
+extern uint64_t hal_sleep_us;
+extern uint64_t hal_stop_us;
+// STOP entered while a DMA transfer was on its way, which it halts
+extern unsigned long hal_stop_dma_errors;
+#define HAL_STOP_WAKEUP_US 5				// from the wakeup event to running again
+
+// the host code takes no virtual time; a tool can charge the MCU's run time for it instead:
+// called as the scheduler starts a task (SCHED_RUN_HOOK), and the CPU running for us
+// microseconds, interrupts served on the way as they would preempt it
+extern void (*hal_task_hook)(int task, void *ctx);
+void hal_compute(uint64_t us);
+extern uint64_t hal_compute_us;			// the time charged so far
+
+uint64_t hal_time_us(void);				// virtual time since HAL_Init()
+
+#endif /* __HAL_STUB_H */
@@ -0,0 +1,54 @@
+/*
+ * mock_icm20948.h
+ *
+ * SPI-level model of the ICM-20948 for the host build. hal_stub.c passes it the chip
+ * select edges and the bytes of HAL_SPI_Transmit()/HAL_SPI_Receive(); it decodes the
+ * register reads and writes of the firmware's driver and serves the accelerometer and
+ * gyroscope output registers from recorded readings (a csv with the "Accel X (g),...,
+ * Gyro Z (dps)" columns of Testing/Simulation Data/Cleaned Data, or the "X,Y,Z,X,Y,Z"
+ * of the Testing/IMU Test Data sheets exported as csv).
+ *
+ * With the FIFO or the data-ready interrupt enabled the sensor samples at its output data
+ * rate in the stub HAL's virtual time: hal_stub.c calls mock_icm20948_advance() as the
+ * time passes, and is called on mock_icm20948_on_int for every pulse of the INT pin.
+ */
+
+#ifndef __MOCK_ICM20948_H
+#define __MOCK_ICM20948_H
+
+#include <stdint.h>
+
+int mock_icm20948_open(const char *csv_path);	// 0 on success
+void mock_icm20948_close(void);
+/*
+ * Until replay starts, the sensor holds the first row, so the firmware's calibration
+ * does not use up the recording.
+ */
+void mock_icm20948_start_replay(void);
+
+void mock_icm20948_select(int selected);		// chip select (active low on the board)
+void mock_icm20948_transmit(const uint8_t *data, uint16_t size);
+void mock_icm20948_receive(uint8_t *data, uint16_t size);
+// full duplex: sends tx and receives into rx, byte for byte; rx may be tx
+void mock_icm20948_exchange(const uint8_t *tx, uint8_t *rx, uint16_t size);
+
+uint64_t mock_icm20948_next_sample_us(void);	// time of the next timed sample, UINT64_MAX if none
+void mock_icm20948_advance(uint64_t now_us);	// takes the timed samples due by now_us
+
+#define MOCK_ICM20948_LOW_NOISE 0
+#define MOCK_ICM20948_LOW_POWER 1
+#define MOCK_ICM20948_SLEEP 2
+#define MOCK_ICM20948_POWER_MODES 3
+uint64_t mock_icm20948_power_us(int mode);	// time spent in a power mode since open
+
+extern unsigned long mock_icm20948_rows;			// rows replayed so far
+extern unsigned long mock_icm20948_transactions;	// chip select cycles so far
+extern unsigned long mock_icm20948_bytes;		// bytes clocked while selected so far
+extern unsigned long mock_icm20948_bank_selects;	// REG_BANK_SEL writes so far
+extern unsigned long mock_icm20948_fifo_overflows;	// samples dropped by a full FIFO
+extern unsigned long mock_icm20948_rate_mismatches;	// samples timed with the accel and gyro dividers unequal
+extern void (*mock_icm20948_on_sample)(unsigned long row);	// a new row is latched
+extern void (*mock_icm20948_on_end)(void);		// the recording ran out; must not return
+extern void (*mock_icm20948_on_int)(void);		// the INT pin pulsed: data ready
+
+#endif /* __MOCK_ICM20948_H */
@@ -0,0 +1,288 @@
+/*
+ * stm32f0xx_hal.h
+ *
+ * Host (Linux) stand-in for the STM32F0 HAL. It declares only the types, constants
+ * and functions that the SHARC_buoy firmware uses so that Core/Src/main.c can be
+ * compiled and run unchanged on a PC. The functions are implemented in hal_stub.c.
+ */
+
+#ifndef __STM32F0xx_HAL_H
+#define __STM32F0xx_HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Status and state types */
+typedef enum
+{
+	HAL_OK = 0x00U,
+	HAL_ERROR = 0x01U,
+	HAL_BUSY = 0x02U,
+	HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+	RESET = 0U,
+	SET = !RESET
+} FlagStatus, ITStatus;
+
+typedef enum
+{
+	GPIO_PIN_RESET = 0U,
+	GPIO_PIN_SET
+} GPIO_PinState;
+
+/* Peripheral instances */
+typedef struct
+{
+	uint32_t id;
+} GPIO_TypeDef, SPI_TypeDef, USART_TypeDef;
+
+extern GPIO_TypeDef host_gpioa, host_gpiob;
+extern SPI_TypeDef host_spi2;
+extern USART_TypeDef host_usart2;
+
+#define GPIOA							(&host_gpioa)
+#define GPIOB							(&host_gpiob)
+#define SPI2							(&host_spi2)
+#define USART2							(&host_usart2)
+
+/* GPIO */
+#define GPIO_PIN_11						((uint16_t)0x0800U)
+#define GPIO_PIN_12						((uint16_t)0x1000U)
+#define GPIO_PIN_13						((uint16_t)0x2000U)
+#define GPIO_PIN_14						((uint16_t)0x4000U)
+#define GPIO_PIN_15						((uint16_t)0x8000U)
+
+#define GPIO_MODE_OUTPUT_PP				0x00000001U
+#define GPIO_MODE_AF_PP					0x00000002U
+#define GPIO_MODE_IT_RISING				0x10110000U
+#define GPIO_NOPULL						0x00000000U
+#define GPIO_SPEED_FREQ_LOW				0x00000000U
+#define GPIO_SPEED_FREQ_HIGH			0x00000003U
+
+typedef struct
+{
+	uint32_t Pin;
+	uint32_t Mode;
+	uint32_t Pull;
+	uint32_t Speed;
+	uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+/* RCC */
+#define RCC_OSCILLATORTYPE_HSI			0x00000002U
+#define RCC_HSI_ON						0x00000001U
+#define RCC_HSICALIBRATION_DEFAULT		0x10U
+#define RCC_PLL_NONE					0x00000000U
+#define RCC_CLOCKTYPE_SYSCLK			0x00000001U
+#define RCC_CLOCKTYPE_HCLK				0x00000002U
+#define RCC_CLOCKTYPE_PCLK1				0x00000004U
+#define RCC_SYSCLKSOURCE_HSI			0x00000000U
+#define RCC_SYSCLK_DIV1					0x00000000U
+#define RCC_HCLK_DIV1					0x00000000U
+#define FLASH_LATENCY_0					0x00000000U
+
+typedef struct
+{
+	uint32_t PLLState;
+} RCC_PLLInitTypeDef;
+
+typedef struct
+{
+	uint32_t OscillatorType;
+	uint32_t HSIState;
+	uint32_t HSICalibrationValue;
+	RCC_PLLInitTypeDef PLL;
+} RCC_OscInitTypeDef;
+
+typedef struct
+{
+	uint32_t ClockType;
+	uint32_t SYSCLKSource;
+	uint32_t AHBCLKDivider;
+	uint32_t APB1CLKDivider;
+} RCC_ClkInitTypeDef;
+
+#define __HAL_RCC_GPIOA_CLK_ENABLE()	do { } while (0)
+#define __HAL_RCC_GPIOB_CLK_ENABLE()	do { } while (0)
+#define __HAL_RCC_DMA1_CLK_ENABLE()		do { } while (0)
+
+/* SPI */
+#define SPI_MODE_MASTER					0x00000104U
+#define SPI_DIRECTION_2LINES			0x00000000U
+#define SPI_DATASIZE_8BIT				0x00000700U
+#define SPI_POLARITY_LOW				0x00000000U
+#define SPI_PHASE_1EDGE					0x00000000U
+#define SPI_NSS_SOFT					0x00000200U
+#define SPI_BAUDRATEPRESCALER_2			0x00000000U
+#define SPI_FIRSTBIT_MSB				0x00000000U
+#define SPI_TIMODE_DISABLE				0x00000000U
+#define SPI_CRCCALCULATION_DISABLE		0x00000000U
+#define SPI_CRC_LENGTH_DATASIZE			0x00000000U
+#define SPI_NSS_PULSE_ENABLE			0x00000008U
+
+typedef struct
+{
+	uint32_t Mode;
+	uint32_t Direction;
+	uint32_t DataSize;
+	uint32_t CLKPolarity;
+	uint32_t CLKPhase;
+	uint32_t NSS;
+	uint32_t BaudRatePrescaler;
+	uint32_t FirstBit;
+	uint32_t TIMode;
+	uint32_t CRCCalculation;
+	uint32_t CRCPolynomial;
+	uint32_t CRCLength;
+	uint32_t NSSPMode;
+} SPI_InitTypeDef;
+
+typedef struct
+{
+	SPI_TypeDef *Instance;
+	SPI_InitTypeDef Init;
+} SPI_HandleTypeDef;
+
+/* UART */
+#define UART_WORDLENGTH_8B				0x00000000U
+#define UART_STOPBITS_1					0x00000000U
+#define UART_PARITY_NONE				0x00000000U
+#define UART_MODE_TX_RX					0x0000000CU
+#define UART_HWCONTROL_NONE				0x00000000U
+#define UART_OVERSAMPLING_16			0x00000000U
+#define UART_ONE_BIT_SAMPLE_DISABLE		0x00000000U
+#define UART_ADVFEATURE_NO_INIT			0x00000000U
+
+typedef struct
+{
+	uint32_t BaudRate;
+	uint32_t WordLength;
+	uint32_t StopBits;
+	uint32_t Parity;
+	uint32_t Mode;
+	uint32_t HwFlowCtl;
+	uint32_t OverSampling;
+	uint32_t OneBitSampling;
+} UART_InitTypeDef;
+
+typedef struct
+{
+	uint32_t AdvFeatureInit;
+} UART_AdvFeatureInitTypeDef;
+
+typedef struct
+{
+	USART_TypeDef *Instance;
+	UART_InitTypeDef Init;
+	UART_AdvFeatureInitTypeDef AdvancedInit;
+} UART_HandleTypeDef;
+
+/* DMA (set up by HAL_UART_MspInit() and HAL_SPI_MspInit(), which the host build does not have) */
+typedef struct
+{
+	void *Instance;
+} DMA_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+
+/* Core */
+typedef enum
+{
+	SysTick_IRQn = -1,
+	EXTI4_15_IRQn = 7,
+	DMA1_Channel4_5_IRQn = 11,
+	USART2_IRQn = 28
+} IRQn_Type;
+
+/* SysTick counts down from LOAD to 0 once a millisecond; VAL follows the virtual time */
+typedef struct
+{
+	uint32_t CTRL;
+	uint32_t LOAD;
+	uint32_t VAL;
+	uint32_t CALIB;
+} SysTick_Type;
+
+SysTick_Type *hal_systick(void);
+#define SysTick							(hal_systick())
+
+/* the PRIMASK: interrupts that come while it is set run when it is cleared */
+#define __disable_irq()					hal_irq_mask(1)
+#define __enable_irq()					hal_irq_mask(0)
+void hal_irq_mask(int masked);
+
+/* SCB: the stub never has SysTick's interrupt pending */
+typedef struct
+{
+	uint32_t ICSR;
+} SCB_Type;
+
+extern SCB_Type host_scb;
+#define SCB								(&host_scb)
+#define SCB_ICSR_PENDSTSET_Msk			(1UL << 26)
+
+/* PWR: STOP stands the clocks, SysTick's included, still until an EXTI line wakes it */
+#define PWR_MAINREGULATOR_ON			0x00000000U
+#define PWR_LOWPOWERREGULATOR_ON		0x00000001U
+#define PWR_STOPENTRY_WFI				((uint8_t)0x01U)
+void HAL_PWR_EnterSTOPMode(uint32_t Regulator, uint8_t STOPEntry);
+int hal_exti_pending(uint16_t GPIO_Pin);
+#define __HAL_GPIO_EXTI_GET_IT(pin)		hal_exti_pending(pin)
+#define __WFI()							hal_wfi()
+void hal_wfi(void);	// sleeps until the next interrupt: the sensor's, or SysTick's every ms
+
+/* the scheduler (scheduler.c) calls this as a task starts: see hal_task_hook in hal_stub.h */
+#define SCHED_RUN_HOOK(task, ctx)		hal_task_run(task, ctx)
+void hal_task_run(int task, void *ctx);
+
+/* HAL functions used by the firmware */
+HAL_StatusTypeDef HAL_Init(void);
+void HAL_Delay(uint32_t Delay);
+uint32_t HAL_GetTick(void);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+extern volatile uint32_t uwTick;	// ms added to HAL_GetTick(); the HAL's own tick count on the board
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct);
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency);
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin);
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi);
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size);
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi);
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+
+/* FLASH: the stub has the last two pages of the F051's flash (the boot log), at their addresses */
+#define FLASH_PAGE_SIZE					0x400U
+#define FLASH_TYPEERASE_PAGES			0x00U
+#define FLASH_TYPEPROGRAM_WORD			0x02U
+
+typedef struct
+{
+	uint32_t TypeErase;
+	uint32_t PageAddress;
+	uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+
+#endif /* __STM32F0xx_HAL_H */
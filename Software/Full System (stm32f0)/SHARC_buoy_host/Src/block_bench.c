@@ -0,0 +1,374 @@
+/*
+ * block_bench.c
+ *
+ * Host benchmark for the per-block work done by the SHARC_buoy firmware. The firmware's
+ * main.c is compiled against the stub HAL and its two block pipelines are timed on the
+ * same blocks of readings:
+ *   RSA path:  encrypt()  - per-byte RSA, then LZSS
+ *   AEAD path: seal()     - LZSS, then one ChaCha20-Poly1305, Ascon-128 or SipHash-2-4 frame (SHARC_CIPHER)
+ * Every sealed frame is opened and decompressed again to check that the block round-trips,
+ * with the nonce it carries, and after the blocks aead_init() is run again, as after a reset,
+ * to check that it starts on a new boot number.
+ *
+ * The readings are quantised to sensor counts as the ICM-20948 would deliver them, and
+ * each block is built as text records (format_record() at a cursor, as main.c does) and as
+ * binary records (pack_record(), SHARC_RECORD_BINARY); the binary block is checked to give
+ * the same text on the ground and sealed as well, for its size. The text block is also
+ * built the way main.c used to, with sprintf() and strncat(), which rescans the block for
+ * every reading, and has to come out the same. Before the blocks, put_hundredths() is
+ * checked against "%.2f" for every sensor count at both full scales.
+ *
+ * The stages of the tasks are also timed on their own, per reading or per byte they take
+ * (the "stages" line): the costs sim.c charges the tasks are from it.
+ *
+ * Usage: block_bench [csv file] [readings per block]
+ * At most SHARC_BLOCK_READINGS readings per block, which sizes main.c's arrays; make
+ * bench-blocks builds it for larger blocks.
+ * The csv file must have the "Accel X (g),...,Gyro Z (dps)" columns of the files in
+ * Testing/Simulation Data/Cleaned Data.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "main.h"
+#include "frame.h"
+#include "ground.h"
+
+#define MAX_READINGS SHARC_BLOCK_READINGS // main.c's arrays are sized for a block
+#define READING_LEN SHARC_READING_TEXT_MAX  // the longest text record
+#define RECORD_LEN 12   // SHARC_RECORD_BINARY without timestamps
+
+/* counts per g and per dps at the full scales icm20948_init() selects (2 g, 2000 dps) */
+#define ACCEL_SCALE 16384.0f
+#define GYRO_SCALE 16.4f
+
+/* firmware state (main.c) */
+extern int8_t compressed[];
+extern int compressedBits;
+extern uint8_t encryptedData[];
+extern int encryptedBits;
+extern uint64_t seqnr;
+extern uint8_t sealedData[];
+extern int sealedBytes;
+
+/* the stages of main.c's tasks, timed on their own for the sim's cost model (sim.c) */
+void icm20948_convert(const icm20948_raw *raw, icm20948_sample *sample);
+void rsa_encrypt(char msg[], int len);
+void aead_stage(const uint8_t msg[], int len);
+void compress(const uint8_t encryptedData[], int encryptedBits);
+void aead_seal(void);
+
+static const char *default_csv = "../../../Testing/Simulation Data/Cleaned Data/STM32ArrayData.csv";
+
+static unsigned long long counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char *unit = "cycles";
+#else
+static const char *unit = "ns";
+#endif
+
+static int16_t counts(float value, float scale)
+{
+	long x = lroundf(value * scale);
+	return x > INT16_MAX ? INT16_MAX : x < INT16_MIN ? INT16_MIN : x;
+}
+
+/**
+ * Reads the next row of the csv as the sensor counts of a reading, in the axises the
+ * firmware's raw reads fill in. Returns 0 at the end of the file.
+ */
+static int next_reading(FILE *csv, int column, axises *accel, axises *gyro)
+{
+	char line[256];
+	float v[6];
+
+	while (fgets(line, sizeof(line), csv) != NULL) {
+		char *p = line;
+		int i;
+		for (i = 0; i < column && p != NULL; i++) {
+			p = strchr(p, ',');
+			if (p != NULL) p++;
+		}
+		if (p == NULL || sscanf(p, "%f,%f,%f,%f,%f,%f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 6) {
+			continue;
+		}
+		accel->x = counts(v[0], ACCEL_SCALE);
+		accel->y = counts(v[1], ACCEL_SCALE);
+		accel->z = counts(v[2], ACCEL_SCALE);
+		gyro->x = counts(v[3], GYRO_SCALE);
+		gyro->y = counts(v[4], GYRO_SCALE);
+		gyro->z = counts(v[5], GYRO_SCALE);
+		return 1;
+	}
+	return 0;
+}
+
+/* the sample the data-ready interrupt would have put in the ring for a reading */
+static void to_sample(const axises *accel, const axises *gyro, struct sample *s)
+{
+	s->raw.accel[0] = accel->x;  s->raw.accel[1] = accel->y;  s->raw.accel[2] = accel->z;
+	s->raw.gyro[0] = gyro->x;  s->raw.gyro[1] = gyro->y;  s->raw.gyro[2] = gyro->z;
+	s->tick = 0;
+}
+
+/* the reading in g and dps, as icm20948_convert() gives it to main.c */
+static void to_units(const axises *accel, const axises *gyro, icm20948_sample *s)
+{
+	s->accel_g.x = accel->x / ACCEL_SCALE;  s->accel_g.y = accel->y / ACCEL_SCALE;  s->accel_g.z = accel->z / ACCEL_SCALE;
+	s->gyro_dps.x = gyro->x / GYRO_SCALE;  s->gyro_dps.y = gyro->y / GYRO_SCALE;  s->gyro_dps.z = gyro->z / GYRO_SCALE;
+}
+
+/* the text record main.c made of a reading with sprintf() */
+static int sprintf_reading(const icm20948_sample *s, char reading[READING_LEN + 1])
+{
+	return sprintf(reading, "\r\n%.2f,%.2f,%.2f,%.2f,%.2f,%.2f;", s->accel_g.x, s->accel_g.y, s->accel_g.z,
+			s->gyro_dps.x, s->gyro_dps.y, s->gyro_dps.z);
+}
+
+/* put_hundredths() against printf's "%.2f" for every count at both full scales; returns the mismatches */
+static int check_hundredths(void)
+{
+	static const float scales[] = { ACCEL_SCALE, GYRO_SCALE };
+	char want[32], got[32];
+	int i, c, failures = 0;
+
+	for (i = 0; i < 2; i++) {
+		for (c = INT16_MIN; c <= INT16_MAX; c++) {
+			float v = c / scales[i];
+			sprintf(want, "%.2f", v);
+			*put_hundredths(got, v) = '\0';
+			if (strcmp(want, got) != 0 && failures++ < 10) {
+				printf("count %d / %.1f: put_hundredths() gives %s, printf %s\n", c, scales[i], got, want);
+			}
+		}
+	}
+	return failures;
+}
+
+/* finds the "Accel X (g)" column in the header row */
+static int accel_column(FILE *csv)
+{
+	char line[256];
+	int column = 0;
+	char *p;
+
+	if (fgets(line, sizeof(line), csv) == NULL) return -1;
+	for (p = strtok(line, ","); p != NULL; p = strtok(NULL, ","), column++) {
+		if (strncmp(p, "Accel X", 7) == 0) return column;
+	}
+	return -1;
+}
+
+/* opens the frame seal() just produced and checks it against the block */
+static int verify_frame(const char *block, int blocklen)
+{
+	char text[MAX_READINGS * READING_LEN + 1];
+	uint64_t nonce;
+	int textlen = ground_open_frame(sealedData, sealedBytes, &nonce, text, sizeof(text));
+
+	return nonce == seqnr - 1 && textlen == blocklen && memcmp(text, block, blocklen) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *path = argc > 1 ? argv[1] : default_csv;
+	int numReadings = argc > 2 ? atoi(argv[2]) : MAX_READINGS;
+	char inputArray[MAX_READINGS * READING_LEN + 2];
+	char fullText[MAX_READINGS * 80], groundText[MAX_READINGS * 80];
+	uint8_t records[MAX_READINGS * RECORD_LEN];
+	axises accel[MAX_READINGS], gyro[MAX_READINGS];
+	struct sample samples[MAX_READINGS];
+	char reading[READING_LEN + 1], oldArray[MAX_READINGS * READING_LEN + 2];
+	icm20948_sample units[MAX_READINGS];
+	unsigned long long begin, rsa_total = 0, aead_total = 0, text_total = 0, format_total = 0, pack_total = 0;
+	unsigned long long sprintf_total = 0, convert_total = 0, lzss_total = 0, rsa_only_total = 0, seal_total = 0;
+	unsigned long long frame_total = 0, code_text_total = 0, sealed_total = 0, frame_bytes = 0;
+	uint8_t frame[FRAME_ENCODED_MAX(MAX_READINGS * READING_LEN + 64)];
+	char temp[8];
+	icm20948_sample converted;
+	uint32_t boot;
+	unsigned long rsa_bytes = 0, aead_bytes = 0, record_aead_bytes = 0;
+	int blocks = 0, failures = 0, column;
+	FILE *csv;
+
+	if (numReadings < 1 || numReadings > MAX_READINGS) {
+		printf("readings per block must be 1..%d\n", MAX_READINGS);
+		return 1;
+	}
+	if ((csv = fopen(path, "r")) == NULL) {
+		printf("? %s\n", path);
+		return 1;
+	}
+	if ((column = accel_column(csv)) < 0) {
+		printf("? %s: no \"Accel X\" column\n", path);
+		return 1;
+	}
+	HAL_Init();
+	aead_init();
+	boot = seqnr >> 32;
+	ground_init();
+	failures += check_hundredths();
+
+	printf("block,text bytes,rsa bytes,rsa %s,aead bytes,aead %s,record bytes,record aead bytes\n", unit, unit);
+	for (;;) {
+		int i, blocklen, oldlen, recordlen = 0, fulllen = 0;
+		unsigned long long rsa, aead;
+
+		for (i = 0; i < numReadings && next_reading(csv, column, &accel[i], &gyro[i]); i++) {
+			to_sample(&accel[i], &gyro[i], &samples[i]);
+			to_units(&accel[i], &gyro[i], &units[i]);
+		}
+		if (i < numReadings) break;
+
+		// the text block as task_sampling() builds it, and as it did with sprintf() and strncat()
+		begin = counter();
+		blocklen = 0;
+		for (i = 0; i < numReadings; i++) {
+			blocklen += format_record(inputArray + blocklen, &units[i]);
+		}
+		inputArray[blocklen] = '}';
+		inputArray[blocklen + 1] = '\0';
+		format_total += counter() - begin;
+		begin = counter();
+		oldArray[0] = '\0';
+		for (i = 0; i < numReadings; i++) {
+			int n = sprintf_reading(&units[i], reading);
+
+			oldlen = strlen(oldArray);
+			if (oldlen + n + 2 > (int)sizeof(oldArray)) break;	// with the '}' and the '\0'
+			strncat(oldArray, reading, sizeof(oldArray) - oldlen - 2);
+		}
+		oldlen = strlen(oldArray);
+		strcat(oldArray, "}");
+		sprintf_total += counter() - begin;
+		if (oldlen != blocklen || strcmp(oldArray, inputArray) != 0) {
+			printf("block %d: format_record() does not give the sprintf() text\n", blocks);
+			failures++;
+		}
+		begin = counter();
+		for (i = 0; i < numReadings; i++) {
+			recordlen += pack_record(records + recordlen, &samples[i]);
+		}
+		pack_total += counter() - begin;
+
+		// the binary records must give the ground the same readings, uncut
+		for (i = 0; i < numReadings; i++) {
+			sprintf_reading(&units[i], reading);
+			fulllen += sprintf(fullText + fulllen, "%s", reading);
+		}
+		if (ground_records_to_text(records, recordlen, RECORD_LEN, ACCEL_SCALE, GYRO_SCALE, groundText,
+				sizeof(groundText)) != fulllen || memcmp(groundText, fullText, fulllen) != 0) {
+			printf("block %d: binary records do not give the text readings\n", blocks);
+			failures++;
+		}
+
+		reset_block();
+		begin = counter();
+		encrypt(inputArray, blocklen);
+		rsa = counter() - begin;
+		rsa_bytes += compressedBits;
+		printf("%d,%d,%d,%llu,", blocks, blocklen, compressedBits, rsa);
+
+		reset_block();
+		begin = counter();
+		seal((uint8_t *)inputArray, blocklen);
+		aead = counter() - begin;
+		aead_bytes += sealedBytes;
+		printf("%d,%llu,", sealedBytes, aead);
+
+		if (!verify_frame(inputArray, blocklen)) {
+			printf("block %d: sealed frame does not round-trip\n", blocks);
+			failures++;
+		}
+
+		reset_block();
+		seal(records, recordlen);
+		record_aead_bytes += sealedBytes;
+		printf("%d,%d\n", recordlen, sealedBytes);
+		if (!verify_frame((char *)records, recordlen)) {
+			printf("block %d: sealed records do not round-trip\n", blocks);
+			failures++;
+		}
+		// the stages on their own: the work of each task, per reading or per byte it takes
+		begin = counter();
+		for (i = 0; i < numReadings; i++) {
+			icm20948_convert(&samples[i].raw, &converted);
+		}
+		convert_total += counter() - begin;
+		reset_block();
+		begin = counter();
+		rsa_encrypt(inputArray, blocklen);
+		rsa_only_total += counter() - begin;
+		reset_block();
+		aead_stage((uint8_t *)inputArray, blocklen);
+		begin = counter();
+		compress(encryptedData, encryptedBits);
+		lzss_total += counter() - begin;
+		sealed_total += compressedBits;
+		begin = counter();
+		aead_seal();
+		seal_total += counter() - begin;
+		begin = counter();
+		frame_encode(frame, FRAME_TYPE_READINGS, blocks, (uint8_t *)inputArray, blocklen);
+		frame_encode(frame, FRAME_TYPE_SEALED, blocks, sealedData, sealedBytes);
+		frame_total += counter() - begin;
+		frame_bytes += blocklen + sealedBytes;
+		begin = counter();
+		for (i = 0; i < sealedBytes; i++) {
+			sprintf(temp, "\r\n%d,", sealedData[i]); // the text link's code bytes (task_transmission())
+		}
+		code_text_total += counter() - begin;
+
+		rsa_total += rsa;
+		aead_total += aead;
+		text_total += blocklen;
+		blocks++;
+	}
+	fclose(csv);
+
+	if (blocks == 0) {
+		printf("no complete blocks in %s\n", path);
+		return 1;
+	}
+	printf("\n%d blocks of %d readings (%llu text bytes)\n", blocks, numReadings, text_total);
+	printf("rsa+lzss:  %llu %s / block, %.1f %s / byte, %lu bytes out\n", rsa_total / blocks, unit,
+			(double)rsa_total / text_total, unit, rsa_bytes);
+	printf("lzss+aead: %llu %s / block, %.1f %s / byte, %lu bytes out\n", aead_total / blocks, unit,
+			(double)aead_total / text_total, unit, aead_bytes);
+	printf("aead / rsa: %.2f\n", (double)aead_total / rsa_total);
+	printf("text records:   %.1f bytes / reading, %llu %s / reading, %.1f sealed bytes / reading\n",
+			(double)text_total / (blocks * numReadings), format_total / (blocks * numReadings), unit,
+			(double)aead_bytes / (blocks * numReadings));
+	printf("text block:     %llu %s / block with format_record(), %llu with sprintf (%.1fx)\n",
+			format_total / blocks, unit, sprintf_total / blocks, (double)sprintf_total / format_total);
+	printf("binary records: %d bytes / reading, %llu %s / reading, %.1f sealed bytes / reading\n",
+			RECORD_LEN, pack_total / (blocks * numReadings), unit, (double)record_aead_bytes / (blocks * numReadings));
+	printf("stages:         %llu convert %s / reading; %.1f lzss, %.1f rsa, %.1f seal, %.1f frame, %.1f text code %s / byte\n",
+			convert_total / (blocks * numReadings), unit, (double)lzss_total / text_total,
+			(double)rsa_only_total / text_total, (double)seal_total / sealed_total, (double)frame_total / frame_bytes,
+			(double)code_text_total / aead_bytes, unit);
+
+	aead_init();
+	if (seqnr != (uint64_t)(boot + 1) << 32) {
+		printf("after a reset the nonces start at %llx, not on the next boot number\n", (unsigned long long)seqnr);
+		failures++;
+	}
+	return failures != 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * ground.c
+ *
+ * The receiving end of the SHARC_buoy block pipelines (see ground.h).
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ground.h"
+#include "frame.h"
+#include "sharc_config.h"
+#include "ascon_aead.h"
+#include "chachapoly_aead.h"
+#include "poly1305.h"
+#include "siphash.h"
+
+/* the firmware's LZSS window (sharc_config.h) */
+#define EI  SHARC_LZSS_EI
+#define EJ  SHARC_LZSS_EJ
+#define N (1 << EI)
+#define F ((1 << EJ) + 1)
+
+/* must match the RSA key in main.c */
+#define RSA_D 107
+#define RSA_N 187
+
+#define FRAME_MAX (CHACHA20_POLY1305_AEAD_AAD_LEN + SHARC_CODE_MAX + POLY1305_TAGLEN) // a sealed block after its nonce
+
+/* the ground station's copy of the keys in main.c */
+static const uint8_t aead_k_1[CHACHA20_POLY1305_AEAD_KEY_LEN] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+	0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+static const uint8_t aead_k_2[CHACHA20_POLY1305_AEAD_KEY_LEN] = {
+	0xff, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+	0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f};
+
+static struct chachapolyaead_ctx chachapoly;
+static struct asconaead_ctx ascon;
+static struct siphash_ctx siphash;
+
+void ground_init(void)
+{
+	chacha20poly1305_init(&chachapoly, aead_k_1, sizeof(aead_k_1), aead_k_2, sizeof(aead_k_2));
+	ascon128_init(&ascon, aead_k_1, ASCON128_KEY_LEN);
+	siphash24_mac_init(&siphash, aead_k_2, SIPHASH_KEY_LEN);
+}
+
+static int getbit(const uint8_t *in, int inlen, int *pos, int n)
+{
+	int i, x = 0;
+	for (i = 0; i < n; i++) {
+		if (*pos >= inlen * 8) return EOF;
+		x <<= 1;
+		if (in[*pos / 8] & (128 >> (*pos % 8))) x++;
+		(*pos)++;
+	}
+	return x;
+}
+
+/* from Okumura's lzss.c */
+int ground_decompress(const uint8_t *in, int inlen, char *out, int outmax)
+{
+	int i, j, k, r, c, pos = 0, outlen = 0;
+	unsigned char buffer[N * 2];
+
+	for (i = 0; i < N - F; i++) buffer[i] = ' ';
+	r = N - F;
+	while ((c = getbit(in, inlen, &pos, 1)) != EOF) {
+		if (c) {
+			if ((c = getbit(in, inlen, &pos, 8)) == EOF) break;
+			if (outlen >= outmax) return -1;
+			out[outlen++] = c;
+			buffer[r++] = c;  r &= (N - 1);
+		} else {
+			if ((i = getbit(in, inlen, &pos, EI)) == EOF) break;
+			if ((j = getbit(in, inlen, &pos, EJ)) == EOF) break;
+			for (k = 0; k <= j + 1; k++) {
+				c = buffer[(i + k) & (N - 1)];
+				if (outlen >= outmax) return -1;
+				out[outlen++] = c;
+				buffer[r++] = c;  r &= (N - 1);
+			}
+		}
+	}
+	return outlen;
+}
+
+int ground_rsa_open(const uint8_t *code, int codelen, char *text, int textmax)
+{
+	int i, k, len = ground_decompress(code, codelen, text, textmax);
+
+	for (i = 0; i < len; i++) {
+		int c = (uint8_t)text[i], m = 1;
+		for (k = 0; k < RSA_D; k++) m = m * c % RSA_N;
+		text[i] = (char)m;
+	}
+	return len;
+}
+
+int ground_open_frame(const uint8_t *frame, int framelen, uint64_t *nonce, char *text, int textmax)
+{
+	uint8_t opened[FRAME_MAX];
+	const uint8_t *sealed = frame + 1 + FRAME_SEALED_NONCE_LEN;	// after the suite byte and the nonce
+	int sealedlen = framelen - 1 - FRAME_SEALED_NONCE_LEN, taglen, len, i;
+	uint64_t seqnr = 0;
+	uint32_t length;
+
+	if (sealedlen < 0 || sealedlen > (int)sizeof(opened)) return -1;
+	for (i = FRAME_SEALED_NONCE_LEN - 1; i >= 0; i--) {
+		seqnr = seqnr << 8 | frame[1 + i];
+	}
+	*nonce = seqnr;
+	/* the receiver takes the suite from the frame header, and the length from the start of the frame */
+	if (frame[0] == ASCON128_FRAME_SUITE) {
+		taglen = ASCON128_TAGLEN;
+		ascon128_get_length(&ascon, &length, seqnr, sealed);
+		if (ascon128_crypt(&ascon, seqnr, opened, sizeof(opened), sealed, sealedlen, 0) != 0) return -1;
+	} else if (frame[0] == SIPHASH_FRAME_SUITE) {
+		taglen = SIPHASH_TAGLEN;
+		siphash24_mac_get_length(&siphash, &length, seqnr, sealed);
+		if (siphash24_mac_crypt(&siphash, seqnr, opened, sizeof(opened), sealed, sealedlen, 0) != 0) return -1;
+	} else {
+		taglen = POLY1305_TAGLEN;
+		if (chacha20poly1305_set_rounds(&chachapoly, frame[0]) != 0) return -1;
+		chacha20poly1305_get_length(&chachapoly, &length, seqnr, sealed);
+		if (chacha20poly1305_crypt(&chachapoly, seqnr, seqnr / AAD_PACKAGES_PER_ROUND,
+				(seqnr % AAD_PACKAGES_PER_ROUND) * CHACHA20_POLY1305_AEAD_AAD_LEN, opened, sizeof(opened),
+				sealed, sealedlen, 0) != 0) {
+			return -1;
+		}
+	}
+	len = opened[0] | opened[1] << 8 | opened[2] << 16;
+	if ((int)length != len || len != sealedlen - CHACHA20_POLY1305_AEAD_AAD_LEN - taglen) return -1;
+	return ground_decompress(opened + CHACHA20_POLY1305_AEAD_AAD_LEN, len, text, textmax);
+}
+
+int ground_records_to_text(const uint8_t *records, int len, int record_len, float accel_scale, float gyro_scale,
+		char *text, int textmax)
+{
+	int i, k, textlen = 0;
+
+	for (i = 0; i + record_len <= len; i += record_len) {
+		float v[6];
+		char reading[80];
+		int n;
+
+		for (k = 0; k < 6; k++) {
+			// the same float division as icm20948_accel_read_g() and icm20948_gyro_read_dps()
+			v[k] = (int16_t)(records[i + 2 * k] | records[i + 2 * k + 1] << 8);
+			v[k] /= k < 3 ? accel_scale : gyro_scale;
+		}
+		n = sprintf(reading, "\r\n%.2f,%.2f,%.2f,%.2f,%.2f,%.2f;", v[0], v[1], v[2], v[3], v[4], v[5]);
+		if (textlen + n > textmax) return -1;
+		memcpy(text + textlen, reading, n);
+		textlen += n;
+	}
+	return textlen;
+}
@@ -0,0 +1,496 @@
+/*
+ * hal_stub.c
+ *
+ * Host implementation of the HAL functions declared in Inc/stm32f0xx_hal.h.
+ * Time is virtual: HAL_Delay(), the SPI and the UART advance the clock instead of sleeping,
+ * and every byte written to the UART is counted (and optionally captured to a file).
+ * HAL_UART_Transmit_DMA() returns at once; the bytes take their time on the air while the
+ * firmware goes on, and HAL_UART_TxCpltCallback() runs as an interrupt after the last one.
+ * HAL_SPI_Receive_DMA() does the same on the SPI, with HAL_SPI_RxCpltCallback(). Both use
+ * DMA1 channel 4 on the F051: a transfer started while the other is on its way is counted
+ * in hal_dma_conflicts (and not started).
+ * __disable_irq() holds interrupts off until __enable_irq(), and a __WFI() or STOP under it
+ * returns when one is pending without running it. STOP only ends on the sensor's EXTI,
+ * HAL_STOP_WAKEUP_US after it, and HAL_GetTick() and SysTick stand still meanwhile.
+ * SPI2 is wired to the mock ICM-20948 (mock_icm20948.c), with PB12 as its chip select and
+ * its INT pin on PB11. With PB11 set up as a rising edge EXTI and EXTI4_15_IRQn enabled,
+ * every INT pulse runs HAL_GPIO_EXTI_Callback() as the interrupt would: at the time of
+ * the pulse, in the middle of whatever the firmware was waiting for, and never nested.
+ * The last two flash pages are mapped at their addresses at the first HAL_Init(), erased,
+ * and keep what is programmed into them through later ones, as the flash does through a reset.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "stm32f0xx_hal.h"
+#include "hal_stub.h"
+#include "mock_icm20948.h"
+
+GPIO_TypeDef host_gpioa, host_gpiob;
+SPI_TypeDef host_spi2;
+USART_TypeDef host_usart2;
+SCB_Type host_scb;
+volatile uint32_t uwTick;
+
+static uint64_t now_us = 0;
+static uint32_t uart_baud = 9600;
+static int exti_pb11, exti_enabled;	// PB11 is a rising edge EXTI; EXTI4_15_IRQn is enabled
+static int irq_pending, in_irq, irq_masked;
+static uint64_t stopped_us;		// SysTick stood still, in STOP
+static int uart_irq_pending;
+static int uart_blocking;			// inside HAL_UART_Transmit
+static struct {
+	int active;
+	UART_HandleTypeDef *huart;
+	const uint8_t *data;
+	uint16_t size;
+	uint64_t end_us;
+} tx_dma;
+static struct {
+	int active;
+	SPI_HandleTypeDef *hspi;
+	uint64_t end_us;
+} spi_dma;
+static int spi_irq_pending;
+
+unsigned long hal_uart_bytes = 0;
+FILE *hal_uart_capture = NULL;
+void (*hal_uart_tx_start_hook)(const uint8_t *data, uint16_t size) = NULL;
+void (*hal_uart_tx_hook)(const uint8_t *data, uint16_t size) = NULL;
+uint64_t hal_uart_busy_us = 0;
+uint64_t hal_uart_blocked_us = 0;
+uint64_t hal_spi_busy_us = 0;
+uint64_t hal_spi_blocked_us = 0;
+unsigned long hal_dma_conflicts = 0;
+unsigned long hal_uart_dma_fail_every = 0;
+uint64_t hal_sleep_us = 0;
+uint64_t hal_stop_us = 0;
+unsigned long hal_stop_dma_errors = 0;
+void (*hal_task_hook)(int task, void *ctx) = NULL;
+uint64_t hal_compute_us = 0;
+
+uint64_t hal_time_us(void)
+{
+	return now_us;
+}
+
+static void icm_int_pulse(void)
+{
+	if (exti_pb11) irq_pending = 1;
+}
+
+static int irq_waiting(void)
+{
+	return (irq_pending && exti_enabled) || spi_irq_pending || uart_irq_pending;
+}
+
+/*
+ * runs the pending interrupts, unless one is running already (they are tail-chained then)
+ * or they are held off, in the order of their IRQ numbers: EXTI4_15, DMA1_Channel4_5, USART2
+ */
+static void service_irq(void)
+{
+	while (!in_irq && !irq_masked && irq_waiting()) {
+		in_irq = 1;
+		if (irq_pending && exti_enabled) {
+			irq_pending = 0;
+			HAL_GPIO_EXTI_Callback(GPIO_PIN_11);
+		} else if (spi_irq_pending) {
+			spi_irq_pending = 0;
+			HAL_SPI_RxCpltCallback(spi_dma.hspi);
+		} else {
+			uart_irq_pending = 0;
+			HAL_UART_TxCpltCallback(tx_dma.huart);
+		}
+		in_irq = 0;
+	}
+}
+
+/* the last byte of a DMA transmit has left: the transfer complete interrupt follows */
+static void tx_dma_done(void)
+{
+	tx_dma.active = 0;
+	if (hal_uart_tx_hook != NULL) {
+		hal_uart_tx_hook(tx_dma.data, tx_dma.size);
+	}
+	uart_irq_pending = 1;
+}
+
+static uint64_t next_event_us(void)
+{
+	uint64_t next = mock_icm20948_next_sample_us();
+
+	if (tx_dma.active && tx_dma.end_us < next) next = tx_dma.end_us;
+	return spi_dma.active && spi_dma.end_us < next ? spi_dma.end_us : next;
+}
+
+int hal_uart_sending(void)
+{
+	return uart_blocking || tx_dma.active;
+}
+
+/*
+ * advances the virtual time, letting the sensor take the samples due on the way. An
+ * interrupt handler run on the way takes time of its own, which the wait may outlast.
+ */
+static void elapse(uint64_t us)
+{
+	uint64_t end = now_us + us, next;
+
+	while ((next = next_event_us()) <= end) {
+		if (next > now_us) now_us = next;
+		mock_icm20948_advance(now_us);
+		if (tx_dma.active && tx_dma.end_us <= now_us) tx_dma_done();
+		if (spi_dma.active && spi_dma.end_us <= now_us) {
+			spi_dma.active = 0;
+			spi_irq_pending = 1;
+		}
+		service_irq();
+	}
+	if (now_us < end) now_us = end;
+}
+
+#define FLASH_STUB_ADDR		0x0800F800U	// the pages the stub has
+#define FLASH_STUB_PAGES	2
+#define FLASH_HOST_PAGE		4096U		// mmap() maps whole host pages
+
+static int flash_mapped, flash_locked = 1;
+
+static void flash_map(void)
+{
+	uintptr_t base = FLASH_STUB_ADDR & ~(uintptr_t)(FLASH_HOST_PAGE - 1);
+	void *p = mmap((void *)base, FLASH_STUB_ADDR + FLASH_STUB_PAGES * FLASH_PAGE_SIZE - base,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+	if (p != (void *)base) {
+		fprintf(stderr, "hal_stub: cannot map the flash pages at 0x%08x\n", FLASH_STUB_ADDR);
+		exit(1);
+	}
+	memset((void *)(uintptr_t)FLASH_STUB_ADDR, 0xFF, FLASH_STUB_PAGES * FLASH_PAGE_SIZE);
+	flash_mapped = 1;
+}
+
+static int flash_stub_has(uint32_t address, uint32_t len)
+{
+	return address >= FLASH_STUB_ADDR && address - FLASH_STUB_ADDR + len <= FLASH_STUB_PAGES * FLASH_PAGE_SIZE;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+	flash_locked = 0;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+	flash_locked = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError)
+{
+	uint32_t len = pEraseInit->NbPages * FLASH_PAGE_SIZE;
+
+	*PageError = 0xFFFFFFFFU;
+	if (flash_locked || pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES || pEraseInit->PageAddress % FLASH_PAGE_SIZE != 0 ||
+			!flash_stub_has(pEraseInit->PageAddress, len)) {
+		*PageError = pEraseInit->PageAddress;
+		return HAL_ERROR;
+	}
+	memset((void *)(uintptr_t)pEraseInit->PageAddress, 0xFF, len);
+	return HAL_OK;
+}
+
+/* like the flash, a word can only be programmed when it is erased */
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data)
+{
+	volatile uint32_t *word = (volatile uint32_t *)(uintptr_t)Address;
+
+	if (flash_locked || TypeProgram != FLASH_TYPEPROGRAM_WORD || Address % 4 != 0 || !flash_stub_has(Address, 4) ||
+			*word != 0xFFFFFFFFU) {
+		return HAL_ERROR;
+	}
+	*word = (uint32_t)Data;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+	if (!flash_mapped) flash_map();
+	now_us = 0;
+	exti_pb11 = exti_enabled = irq_pending = in_irq = irq_masked = 0;
+	stopped_us = 0;
+	uwTick = 0;
+	uart_irq_pending = uart_blocking = 0;
+	tx_dma.active = 0;
+	spi_dma.active = spi_irq_pending = 0;
+	mock_icm20948_on_int = icm_int_pulse;
+	return HAL_OK;
+}
+
+void hal_irq_mask(int masked)
+{
+	irq_masked = masked;
+	service_irq();
+}
+
+void hal_wfi(void)
+{
+	uint64_t wake = (now_us / 1000 + 1) * 1000, next = mock_icm20948_next_sample_us(), from = now_us;
+
+	service_irq();
+	if (irq_waiting()) return;	// held off: it wakes the core at once
+	if (exti_pb11 && exti_enabled && next < wake) wake = next;
+	if (tx_dma.active && tx_dma.end_us < wake) wake = tx_dma.end_us;
+	if (spi_dma.active && spi_dma.end_us < wake) wake = spi_dma.end_us;
+	elapse(wake - now_us);
+	hal_sleep_us += now_us - from;
+}
+
+void HAL_PWR_EnterSTOPMode(uint32_t Regulator, uint8_t STOPEntry)
+{
+	uint64_t next = mock_icm20948_next_sample_us(), from = now_us;
+
+	(void)Regulator;
+	(void)STOPEntry;
+	if (tx_dma.active || spi_dma.active) hal_stop_dma_errors++;
+	service_irq();
+	if (irq_waiting()) return;
+	if (!exti_pb11 || !exti_enabled || next == UINT64_MAX) {
+		fprintf(stderr, "STOP entered with no EXTI to wake it\n");
+		exit(1);
+	}
+	elapse(next - now_us);
+	elapse(HAL_STOP_WAKEUP_US);
+	hal_stop_us += now_us - from;
+	stopped_us += now_us - from;
+}
+
+void hal_task_run(int task, void *ctx)
+{
+	if (hal_task_hook != NULL) hal_task_hook(task, ctx);
+}
+
+void hal_compute(uint64_t us)
+{
+	elapse(us);
+	hal_compute_us += us;
+}
+
+int hal_exti_pending(uint16_t GPIO_Pin)
+{
+	return GPIO_Pin == GPIO_PIN_11 && irq_pending;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	elapse(Delay * 1000ULL);
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return uwTick + (uint32_t)((now_us - stopped_us) / 1000);
+}
+
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
+
+SysTick_Type *hal_systick(void)
+{
+	static SysTick_Type systick = { .LOAD = 7999 };	// 8 MHz HSI
+
+	systick.VAL = systick.LOAD - (uint32_t)((now_us - stopped_us) % 1000 * (systick.LOAD + 1) / 1000);
+	return &systick;
+}
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+	(void)RCC_OscInitStruct;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+	(void)RCC_ClkInitStruct;
+	(void)FLatency;
+	return HAL_OK;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	if (GPIOx == GPIOB && (GPIO_Init->Pin & GPIO_PIN_11)) {
+		exti_pb11 = GPIO_Init->Mode == GPIO_MODE_IT_RISING;
+	}
+}
+
+__attribute__((weak)) void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+	(void)GPIO_Pin;
+}
+
+__attribute__((weak)) void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	(void)huart;
+}
+
+__attribute__((weak)) void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+	(void)hdma;
+	return HAL_OK;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+	(void)IRQn;
+	(void)PreemptPriority;
+	(void)SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	if (IRQn == EXTI4_15_IRQn) exti_enabled = 1;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	if (IRQn == EXTI4_15_IRQn) exti_enabled = 0;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	if (GPIOx == GPIOB && GPIO_Pin == GPIO_PIN_12) {
+		mock_icm20948_select(PinState == GPIO_PIN_RESET);
+	}
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi)
+{
+	(void)hspi;
+	return HAL_OK;
+}
+
+/* the time Size bytes take on the SPI; a blocking transfer keeps the CPU for all of it */
+static uint64_t spi_us(uint16_t Size, int blocking)
+{
+	uint64_t us = (Size * 8ULL * 1000000ULL) / HAL_SPI_HZ;
+
+	hal_spi_busy_us += us;
+	if (blocking) hal_spi_blocked_us += us;
+	return us;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+	if (hspi->Instance == SPI2) {
+		mock_icm20948_transmit(pData, Size);
+	}
+	elapse(spi_us(Size, 1));
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	(void)Timeout;
+	if (hspi->Instance == SPI2) {
+		mock_icm20948_receive(pData, Size);
+	} else {
+		for (uint16_t i = 0; i < Size; i++) pData[i] = 0;
+	}
+	elapse(spi_us(Size, 1));
+	return HAL_OK;
+}
+
+/*
+ * full duplex, as the HAL does it for a master: pData is sent while it is received into.
+ * The bytes are exchanged at once and the transfer complete interrupt follows as long
+ * after as they take on the wire.
+ */
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	if (spi_dma.active) return HAL_BUSY;
+	if (tx_dma.active) {
+		hal_dma_conflicts++;
+		return HAL_ERROR;
+	}
+	if (hspi->Instance == SPI2) {
+		mock_icm20948_exchange(pData, pData, Size);
+	} else {
+		for (uint16_t i = 0; i < Size; i++) pData[i] = 0;
+	}
+	spi_dma.hspi = hspi;
+	spi_dma.end_us = now_us + spi_us(Size, 0);
+	spi_dma.active = 1;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart)
+{
+	uart_baud = huart->Init.BaudRate;
+	return HAL_OK;
+}
+
+/* counts and captures the bytes of a transmit starting now; returns its time on the air */
+static uint64_t uart_start(const uint8_t *pData, uint16_t Size)
+{
+	// 8N1 framing: 10 bit times per byte
+	uint64_t us = (Size * 10ULL * 1000000ULL) / uart_baud;
+
+	hal_uart_bytes += Size;
+	hal_uart_busy_us += us;
+	if (hal_uart_capture != NULL) {
+		fwrite(pData, 1, Size, hal_uart_capture);
+	}
+	if (hal_uart_tx_start_hook != NULL) {
+		hal_uart_tx_start_hook(pData, Size);
+	}
+	return us;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	uint64_t us;
+
+	(void)huart;
+	(void)Timeout;
+	if (tx_dma.active) return HAL_BUSY;
+	uart_blocking = 1;
+	us = uart_start(pData, Size);
+	hal_uart_blocked_us += us;
+	elapse(us);
+	uart_blocking = 0;
+	if (hal_uart_tx_hook != NULL) {
+		hal_uart_tx_hook(pData, Size);
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size)
+{
+	static unsigned long starts;
+
+	if (tx_dma.active || uart_blocking) return HAL_BUSY;
+	if (hal_uart_dma_fail_every > 0 && ++starts % hal_uart_dma_fail_every == 0) return HAL_ERROR;
+	if (spi_dma.active) {
+		hal_dma_conflicts++;
+		return HAL_ERROR;
+	}
+	tx_dma.huart = huart;
+	tx_dma.data = pData;
+	tx_dma.size = Size;
+	tx_dma.end_us = now_us + uart_start(pData, Size);
+	tx_dma.active = 1;
+	return HAL_OK;
+}
@@ -0,0 +1,368 @@
+/*
+ * mock_icm20948.c
+ *
+ * Register model of the ICM-20948 behind SPI2 (see mock_icm20948.h).
+ *
+ * A transaction starts at the chip select: the first byte is the register address with
+ * the READ bit, and the following bytes are written to / read from consecutive registers.
+ * REG_BANK_SEL selects one of the four user banks.
+ *
+ * The output registers hold one row of the recording, converted to raw counts with the
+ * full scale the firmware selected. A new row is latched when the firmware starts reading
+ * an output group (ACCEL_XOUT_H or GYRO_XOUT_H) again after it has read both groups of the
+ * current row, i.e. once per accelerometer + gyroscope sample.
+ *
+ * Once the FIFO or the data-ready interrupt is enabled, samples are timed instead: a new
+ * row is latched every ODR period (1.125 kHz / (1 + GYRO_SMPLRT_DIV)) of the stub HAL's
+ * virtual time, pushed into the FIFO if it is enabled, and signalled on the INT pin if
+ * the interrupt is. The FIFO is in snapshot mode: when full, new samples are dropped.
+ * The accelerometer's divider (ACCEL_SMPLRT_DIV_1/2) has to be the gyroscope's, or the
+ * FIFO would mix samples of two rates; samples timed while they differ are counted.
+ *
+ * The time the sensor spends in each power mode is kept: asleep (PWR_MGMT_1 SLEEP), in
+ * low-power mode (LP_EN with the accelerometer and gyroscope duty cycled in LP_CONFIG),
+ * or in low-noise mode. Samples are timed the same in every mode.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "icm20948.h"
+#include "mock_icm20948.h"
+#include "hal_stub.h"
+
+#define BANKS 4
+#define REGS 128
+#define ACCEL 0
+#define GYRO 1
+#define FIFO_EN 0x40	// USER_CTRL
+#define RAW_DATA_0_RDY_EN 0x01	// INT_ENABLE_1
+#define ODR_HZ 1125		// the internal sample rate the dividers divide
+
+unsigned long mock_icm20948_rows = 0;
+unsigned long mock_icm20948_transactions = 0;
+unsigned long mock_icm20948_bytes = 0;
+unsigned long mock_icm20948_bank_selects = 0;
+unsigned long mock_icm20948_fifo_overflows = 0;
+unsigned long mock_icm20948_rate_mismatches = 0;
+void (*mock_icm20948_on_sample)(unsigned long row) = NULL;
+void (*mock_icm20948_on_end)(void) = NULL;
+void (*mock_icm20948_on_int)(void) = NULL;
+
+static uint8_t regs[BANKS][REGS];
+static uint8_t bank_sel;
+static int selected, have_address, address, reading;
+
+static FILE *csv;
+static int accel_column;
+static int replaying;
+static float row[6];			// g, g, g, dps, dps, dps
+static int have_row;
+static int group_read[2];		// output group read since the row was latched
+
+static uint8_t fifo[ICM20948_FIFO_SIZE];
+static int fifo_head, fifo_len;
+static int timed;				// samples follow the ODR (FIFO or data-ready interrupt enabled)
+static uint64_t next_clock;		// the ODR_HZ clock cycle of the next timed sample
+static int power_mode;			// MOCK_ICM20948_*
+static uint64_t power_since_us;
+static uint64_t power_us[MOCK_ICM20948_POWER_MODES];
+
+/* the power mode the registers select; the time in the last one is added up first */
+static void update_power(void)
+{
+	uint64_t now = hal_time_us();
+	uint8_t pwr = regs[0][B0_PWR_MGMT_1];
+
+	power_us[power_mode] += now - power_since_us;
+	power_since_us = now;
+	if (pwr & 0x40) power_mode = MOCK_ICM20948_SLEEP;
+	else if ((pwr & 0x20) && (regs[0][B0_LP_CONFIG] & 0x30) == 0x30) power_mode = MOCK_ICM20948_LOW_POWER;
+	else power_mode = MOCK_ICM20948_LOW_NOISE;
+}
+
+static void device_reset(void)
+{
+	memset(regs, 0, sizeof(regs));
+	regs[0][B0_WHO_AM_I] = ICM20948_ID;
+	regs[0][B0_PWR_MGMT_1] = 0x41;
+	regs[0][B0_LP_CONFIG] = 0x40;
+	regs[2][B2_GYRO_CONFIG_1] = 0x01;
+	regs[2][B2_ACCEL_CONFIG] = 0x01;
+	bank_sel = 0;
+	fifo_head = fifo_len = 0;
+	timed = 0;
+	update_power();
+}
+
+/*
+ * finds the "Accel X" column in the header row. The sheets in Testing/IMU Test Data,
+ * exported as csv, have "X,Y,Z,X,Y,Z" headers (accelerometer, then gyroscope).
+ */
+static int find_accel_column(void)
+{
+	char line[256];
+	int column = 0;
+	char *p;
+
+	if (fgets(line, sizeof(line), csv) == NULL) return -1;
+	if (strncmp(line, "X,Y,Z,X,Y,Z", 11) == 0) return 0;
+	for (p = strtok(line, ","); p != NULL; p = strtok(NULL, ","), column++) {
+		if (strncmp(p, "Accel X", 7) == 0) return column;
+	}
+	return -1;
+}
+
+static int next_row(void)
+{
+	char line[256];
+
+	while (fgets(line, sizeof(line), csv) != NULL) {
+		char *p = line;
+		int i;
+		for (i = 0; i < accel_column && p != NULL; i++) {
+			p = strchr(p, ',');
+			if (p != NULL) p++;
+		}
+		if (p != NULL && sscanf(p, "%f,%f,%f,%f,%f,%f", &row[0], &row[1], &row[2], &row[3], &row[4], &row[5]) == 6) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void latch(void)
+{
+	if (!next_row()) {
+		if (mock_icm20948_on_end != NULL) mock_icm20948_on_end();
+		// without a handler the recording starts over
+		rewind(csv);
+		find_accel_column();
+		if (!next_row()) exit(1);
+	}
+	have_row = 1;
+	group_read[ACCEL] = group_read[GYRO] = 0;
+	mock_icm20948_rows++;
+	if (mock_icm20948_on_sample != NULL) mock_icm20948_on_sample(mock_icm20948_rows);
+}
+
+static void start_group(int group)
+{
+	if (!have_row || (replaying && group_read[ACCEL] && group_read[GYRO])) latch();
+	group_read[group] = 1;
+}
+
+static int16_t counts(float value, float sensitivity)
+{
+	long x = lroundf(value * sensitivity);
+	if (x > INT16_MAX) x = INT16_MAX;
+	if (x < INT16_MIN) x = INT16_MIN;
+	return (int16_t)x;
+}
+
+/* bank 0 output registers: accel x, y, z then gyro x, y, z, big-endian */
+static uint8_t output_register(int reg)
+{
+	int i = (reg - B0_ACCEL_XOUT_H) / 2;
+	float accel_sensitivity = 16384 >> ((regs[2][B2_ACCEL_CONFIG] >> 1) & 3);
+	static const float gyro_lsb_per_dps[4] = {131.0f, 65.5f, 32.8f, 16.4f};	// datasheet, not exact halvings
+	float gyro_sensitivity = gyro_lsb_per_dps[(regs[2][B2_GYRO_CONFIG_1] >> 1) & 3];
+	int16_t x = counts(row[i], i < 3 ? accel_sensitivity : gyro_sensitivity);
+
+	return (reg - B0_ACCEL_XOUT_H) % 2 == 0 ? (uint8_t)((uint16_t)x >> 8) : (uint8_t)x;
+}
+
+static uint64_t clock_us(uint64_t cycle)
+{
+	return (cycle * 1000000 + ODR_HZ - 1) / ODR_HZ;
+}
+
+static int fifo_on(void)
+{
+	return (regs[0][B0_USER_CTRL] & FIFO_EN) && regs[0][B0_FIFO_EN_2] != 0;
+}
+
+/* one ODR period of a timed sensor: the next row, into the FIFO, then the data-ready pulse */
+static void timed_sample(void)
+{
+	int i;
+
+	if (replaying || !have_row) latch();
+	if (((regs[2][B2_ACCEL_SMPLRT_DIV_1] & 0x0F) << 8 | regs[2][B2_ACCEL_SMPLRT_DIV_2]) != regs[2][B2_GYRO_SMPLRT_DIV]) {
+		mock_icm20948_rate_mismatches++;
+	}
+	if (fifo_on() && fifo_len + ICM20948_FIFO_SAMPLE_LEN > ICM20948_FIFO_SIZE) {
+		mock_icm20948_fifo_overflows++;
+	} else if (fifo_on()) {
+		for (i = 0; i < ICM20948_FIFO_SAMPLE_LEN; i++, fifo_len++) {
+			fifo[(fifo_head + fifo_len) % ICM20948_FIFO_SIZE] = output_register(B0_ACCEL_XOUT_H + i);
+		}
+	}
+	if ((regs[0][B0_INT_ENABLE_1] & RAW_DATA_0_RDY_EN) && mock_icm20948_on_int != NULL) mock_icm20948_on_int();
+}
+
+static uint8_t fifo_pop(void)
+{
+	uint8_t b;
+
+	if (fifo_len == 0) return 0xFF;
+	b = fifo[fifo_head];
+	fifo_head = (fifo_head + 1) % ICM20948_FIFO_SIZE;
+	fifo_len--;
+	return b;
+}
+
+/*
+ * samples are timed once the FIFO is on (USER_CTRL and FIFO_EN_2) or the data-ready
+ * interrupt is enabled; the first sample follows one period later
+ */
+static void update_timing(void)
+{
+	int on = fifo_on() || (regs[0][B0_INT_ENABLE_1] & RAW_DATA_0_RDY_EN);
+
+	if (on && !timed) {
+		next_clock = hal_time_us() * ODR_HZ / 1000000 + 1 + regs[2][B2_GYRO_SMPLRT_DIV];
+	}
+	timed = on;
+}
+
+static uint8_t read_register(int reg)
+{
+	if (reg == REG_BANK_SEL) return bank_sel;
+	if (bank_sel >> 4 == 0) {
+		if (!timed && reg == B0_ACCEL_XOUT_H) start_group(ACCEL);
+		if (!timed && reg == B0_GYRO_XOUT_H) start_group(GYRO);
+		if (reg >= B0_ACCEL_XOUT_H && reg <= B0_GYRO_ZOUT_L) return output_register(reg);
+		if (reg == B0_FIFO_COUNTH) return (fifo_len >> 8) & 0x1F;
+		if (reg == B0_FIFO_COUNTL) return fifo_len & 0xFF;
+		if (reg == B0_FIFO_R_W) return fifo_pop();
+	}
+	return regs[bank_sel >> 4][reg];
+}
+
+static void write_register(int reg, uint8_t val)
+{
+	if (reg == REG_BANK_SEL) {
+		bank_sel = val & 0x30;
+		mock_icm20948_bank_selects++;
+	} else if (bank_sel >> 4 == 0 && reg == B0_PWR_MGMT_1 && (val & 0x80)) {
+		device_reset();
+	} else {
+		regs[bank_sel >> 4][reg] = val;
+		if (bank_sel >> 4 == 0 && reg == B0_FIFO_RST && val != 0) fifo_head = fifo_len = 0;
+		if (bank_sel >> 4 == 0 && (reg == B0_PWR_MGMT_1 || reg == B0_LP_CONFIG)) update_power();
+		update_timing();
+	}
+}
+
+uint64_t mock_icm20948_next_sample_us(void)
+{
+	return timed ? clock_us(next_clock) : UINT64_MAX;
+}
+
+void mock_icm20948_advance(uint64_t now_us)
+{
+	while (timed && clock_us(next_clock) <= now_us) {
+		next_clock += 1 + regs[2][B2_GYRO_SMPLRT_DIV];
+		timed_sample();
+	}
+}
+
+int mock_icm20948_open(const char *csv_path)
+{
+	if ((csv = fopen(csv_path, "r")) == NULL) return -1;
+	if ((accel_column = find_accel_column()) < 0) {
+		fclose(csv);
+		csv = NULL;
+		return -1;
+	}
+	device_reset();
+	replaying = 0;
+	have_row = 0;
+	mock_icm20948_rows = 0;
+	mock_icm20948_transactions = 0;
+	mock_icm20948_bytes = 0;
+	mock_icm20948_bank_selects = 0;
+	mock_icm20948_fifo_overflows = 0;
+	mock_icm20948_rate_mismatches = 0;
+	memset(power_us, 0, sizeof(power_us));
+	power_since_us = hal_time_us();
+	return 0;
+}
+
+uint64_t mock_icm20948_power_us(int mode)
+{
+	update_power();
+	return power_us[mode];
+}
+
+void mock_icm20948_close(void)
+{
+	if (csv != NULL) fclose(csv);
+	csv = NULL;
+}
+
+void mock_icm20948_start_replay(void)
+{
+	replaying = 1;
+}
+
+void mock_icm20948_select(int select)
+{
+	if (select && !selected) mock_icm20948_transactions++;
+	selected = select;
+	have_address = 0;
+}
+
+void mock_icm20948_transmit(const uint8_t *data, uint16_t size)
+{
+	uint16_t i = 0;
+
+	if (!selected || csv == NULL) return;
+	mock_icm20948_bytes += size;
+	if (!have_address && size > 0) {
+		have_address = 1;
+		reading = (data[0] & READ) != 0;
+		address = data[0] & 0x7F;
+		i = 1;
+	}
+	for (; i < size && !reading; i++) {
+		write_register(address, data[i]);
+		address = (address + 1) & (REGS - 1);
+	}
+}
+
+void mock_icm20948_exchange(const uint8_t *tx, uint8_t *rx, uint16_t size)
+{
+	uint16_t i;
+
+	// the byte out is taken before the byte in is stored, as the SPI shifts them
+	for (i = 0; i < size; i++) {
+		uint8_t out = tx[i];
+		if (selected && csv != NULL && have_address && reading) {
+			mock_icm20948_receive(&rx[i], 1);
+		} else {
+			mock_icm20948_transmit(&out, 1);
+			rx[i] = 0;
+		}
+	}
+}
+
+void mock_icm20948_receive(uint8_t *data, uint16_t size)
+{
+	uint16_t i;
+
+	if (selected) mock_icm20948_bytes += size;
+	for (i = 0; i < size; i++) {
+		if (!selected || csv == NULL || !have_address || !reading) {
+			data[i] = 0;
+			continue;
+		}
+		data[i] = read_register(address);
+		// FIFO_R_W does not auto-increment: a burst reads the FIFO
+		if (bank_sel >> 4 != 0 || address != B0_FIFO_R_W) address = (address + 1) & (REGS - 1);
+	}
+}
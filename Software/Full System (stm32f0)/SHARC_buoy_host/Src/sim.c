@@ -0,0 +1,499 @@
+/*
+ * sim.c
+ *
+ * Host simulation of the SHARC_buoy firmware. main.c runs unchanged (as sharc_main())
+ * against the stub HAL: its SPI reads are answered by the mock ICM-20948 replaying a
+ * recording, and its UART output is parsed the way the ground station does it (text, or
+ * binary frames with SHARC_LINK_FRAMES). Every block received is decoded again and
+ * compared with the plaintext block sent before it.
+ *
+ * The firmware reads the sensor on its data-ready interrupt, which the stub HAL runs at
+ * the mock's output data rate, into a ring the main loop empties. A block's latency is
+ * from the sample of its first reading to the last byte of its code. Samples that found
+ * the ring full are dropped, and reported.
+ *
+ * The sample duty cycle is the share of the sensor's samples, from the first reading of
+ * the first block to the last reading of the last, that went out in a block. The firmware
+ * used to stop reading while it encrypted and sent a block; a pipeline that never does
+ * has a duty cycle of 100 %.
+ *
+ * The samples come out of the sensor's FIFO by SPI DMA. Reported is the share of the SPI
+ * time (from the first sample on) the CPU was free rather than blocked in a transfer,
+ * and any DMA transfer started on the channel the SPI and the UART share while the other
+ * had it, which fails the run.
+ *
+ * Frames are sent by DMA, so the firmware goes on while they are on the air. Reported
+ * are the time the UART was sending, the share of it the CPU was free rather than
+ * blocked in HAL_UART_Transmit(), and the samples read meanwhile.
+ *
+ * The block pipeline runs as the tasks of main.c's scheduler (scheduler.h). Reported per
+ * task are its runs, the time it ran, its longest run and latency (made ready to done)
+ * and its deadline misses, and the CPU load over the run and over the busiest
+ * housekeeping period. Each task is charged the modelled run time of its computation
+ * (below). The status frames housekeeping sends (SHARC_LINK_FRAMES) are counted, and one
+ * whose figures are ahead of the scheduler's fails the run.
+ *
+ * The energy per reading sent is estimated from the time the MCU ran, slept (__WFI())
+ * and stopped (STOP, SHARC_POWER_LOW) and the time the sensor spent in each power mode,
+ * at the typical supply currents below. The run time includes the tasks' modelled
+ * computation, and the part of the MCU's energy it takes is reported too. Reported with
+ * it is how far the firmware's clock is off the virtual time after setting the tick
+ * forward for every STOP, and any STOP entered while a DMA transfer was on its way,
+ * which fails the run.
+ *
+ * Time is virtual (see hal_stub.c): the SPI and UART take as long as their bytes need on
+ * the wire, HAL_Delay() as long as asked and each task the modelled time of its
+ * computation. The results are therefore deterministic and can be compared between builds.
+ *
+ * Usage: sim [-n blocks] [-o capture file] [-e n] [csv file]
+ * -e n makes every n-th DMA transmit fail to start, which the firmware has to retry.
+ * The csv file must have the "Accel X (g),...,Gyro Z (dps)" columns of the files in
+ * Testing/Simulation Data/Cleaned Data.
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "main.h"
+#include "hal_stub.h"
+#include "mock_icm20948.h"
+#include "ground.h"
+#include "frame.h"
+#include "scheduler.h"
+
+
+#define TEXT_MAX (SHARC_BLOCK_READINGS * SHARC_READING_TEXT_MAX + 2)	// inputArray in main.c, or the text of its records
+#define CODE_MAX (SHARC_CODE_MAX + 20)	// compressed[] / sealedData[] in main.c
+#define LATCH_LOG 4096	// rows and readings whose sample time is kept, more than a block spans
+
+/*
+ * Supply currents in mA, typical datasheet figures at 3.3 V, to be replaced by the board's
+ * measured ones: the STM32F051 on the 8 MHz HSI with its peripherals clocked, and the
+ * ICM-20948 with the accelerometer and gyroscope on (low-power mode at 102 Hz; the buoy
+ * samples slower, so this is an upper bound).
+ */
+#define SUPPLY_V 3.3
+#define MCU_RUN_MA 3.0
+#define MCU_SLEEP_MA 1.5
+#define MCU_STOP_MA 0.005
+#define IMU_LOW_NOISE_MA 3.11
+#define IMU_LOW_POWER_MA 1.30
+#define IMU_SLEEP_MA 0.008
+
+static const double imu_ma[MOCK_ICM20948_POWER_MODES] = { IMU_LOW_NOISE_MA, IMU_LOW_POWER_MA, IMU_SLEEP_MA };
+
+/*
+ * The host runs the firmware's computation in no virtual time, so each task is charged its
+ * run time on the STM32F051 as it starts: host cycles per reading or per byte it takes,
+ * from block_bench's "stages" line (make bench), times M0_CYCLES_PER_HOST_CYCLE at the
+ * 8 MHz HSI. The factor is a rough one for the Cortex-M0, which has no divider and no FPU
+ * and runs one instruction at a time; Software/Encryption's m0_icount.sh counts the M0's
+ * instructions per byte of the ciphers, a better figure for COST_SEAL. Interrupt handlers
+ * are not charged.
+ */
+#define MCU_HZ 8000000
+#define M0_CYCLES_PER_HOST_CYCLE 8
+#define COST_CONVERT 25			// icm20948_convert(), per reading
+#define COST_FORMAT 600			// format_record(), per reading
+#define COST_PACK 25			// pack_record(), per reading
+#define COST_LZSS 90			// compress(), per byte of the block
+#define COST_RSA 8				// rsa_encrypt(), per byte of the block
+#if SHARC_CIPHER == SHARC_CIPHER_ASCON
+#define COST_SEAL 20			// aead_seal(), per byte of LZSS code
+#elif SHARC_CIPHER == SHARC_CIPHER_SIPHASH
+#define COST_SEAL 5
+#else
+#define COST_SEAL 15
+#endif
+#define COST_FRAME 28			// frame_encode(), per payload byte
+#define COST_CODE_TEXT 190		// "\r\n%d," on the text link, per code byte
+#define COST_HOUSEKEEPING 200	// sched_load() and tx_retry()
+
+int sharc_main(void);
+extern struct sample_ring sampleRing;
+extern unsigned long txWaits, txRetries;
+extern struct sched sched;
+extern uint16_t cpuLoadMax;
+extern int compressedBits, sealedBytes;
+
+static const char *default_csv = "../../../Testing/Simulation Data/Cleaned Data/Walking Around Example Data.csv";
+
+static jmp_buf stop;
+static unsigned long max_blocks = 10;
+
+static int replaying;
+static char text[TEXT_MAX];		// the last plaintext block, text or binary records
+static int textlen;
+static uint8_t code[CODE_MAX];	// the code bytes of the block being received
+static int codelen, in_code;
+static uint64_t code_end_us;
+static uint64_t latch_us[LATCH_LOG];	// when each row was latched, by row number
+static uint64_t reading_us[LATCH_LOG];	// when each reading was sampled, by its place in the ring
+static unsigned long reading_row[LATCH_LOG];	// the row each reading was sampled in, likewise
+static unsigned long first_row, last_row;	// of the first and the last reading sent in a block
+static unsigned long next_row;	// the row of the next reading to enter the ring (or be dropped)
+static uint64_t spi_busy0_us, spi_blocked0_us;	// the SPI times when replay started
+static uint64_t block_seq;		// the sequence number of the block being received
+#if SHARC_LINK == SHARC_LINK_FRAMES
+static struct frame_parser parser;
+_Static_assert(FRAME_ENCODED_MAX(CODE_MAX) <= FRAME_PARSER_MAX, "the largest frame does not fit the parser");
+#endif
+
+static struct {
+	unsigned long blocks, failed, readings, text_bytes, code_bytes, tx_samples, status, status_bad;
+	uint64_t latency_min, latency_max, latency_sum;
+} stats;
+
+/* the host cycles of the task about to run, by its name in main.c's schedTasks */
+static unsigned long task_cost(int task, const struct block *b)
+{
+	const char *name = sched.tasks[task].name;
+	unsigned long code = SHARC_CIPHER == SHARC_CIPHER_RSA ? compressedBits : sealedBytes;
+
+	if (strcmp(name, "sampling") == 0) {
+		return SHARC_BLOCK_READINGS * (SHARC_RECORD == SHARC_RECORD_BINARY ? COST_PACK : COST_CONVERT + COST_FORMAT);
+	} else if (strcmp(name, "compression") == 0) {
+		return b->len * COST_LZSS;	// RSA turns every byte of the block into a byte of code
+	} else if (strcmp(name, "crypto") == 0) {
+		return SHARC_CIPHER == SHARC_CIPHER_RSA ? b->len * COST_RSA : compressedBits * COST_SEAL;
+	} else if (strcmp(name, "transmission") == 0) {
+		return SHARC_LINK == SHARC_LINK_FRAMES ? (b->len + code) * COST_FRAME : code * COST_CODE_TEXT;
+	} else if (strcmp(name, "housekeeping") == 0) {
+#if SHARC_LINK == SHARC_LINK_FRAMES && SHARC_STATUS_PERIOD_S > 0
+		// a status frame is due every SHARC_STATUS_PERIOD_S runs, unless the last one had to wait
+		if ((sched.stats[task].runs + 1) % SHARC_STATUS_PERIOD_S == 0) {
+			return COST_HOUSEKEEPING + FRAME_STATUS_LEN(sched.n) * COST_FRAME;
+		}
+#endif
+		return COST_HOUSEKEEPING;
+	}
+	return 0;
+}
+
+static void task_started(int task, void *ctx)
+{
+	hal_compute(task_cost(task, ctx) * M0_CYCLES_PER_HOST_CYCLE * 1000000ULL / MCU_HZ);
+}
+
+/*
+ * gives the readings that entered the ring since the last call the sample times of their
+ * rows, which the sensor takes, and the firmware pushes or drops, in order. A burst from
+ * the FIFO pushes until the ring is full, then drops: the pushes come first.
+ */
+static void account(void)
+{
+	static uint16_t pushed, dropped;
+
+	while (pushed != sampleRing.head) {
+		reading_row[pushed % LATCH_LOG] = next_row;
+		reading_us[pushed++ % LATCH_LOG] = latch_us[next_row++ % LATCH_LOG];
+	}
+	while (dropped != sampleRing.dropped) {
+		dropped++;
+		next_row++;
+	}
+}
+
+/* checks the block that just ended against the plaintext sent before it */
+static void finish_block(void)
+{
+	char decoded[TEXT_MAX];
+	uint64_t latency;
+	int i, len;
+#if SHARC_CIPHER != SHARC_CIPHER_RSA
+	static uint64_t last_nonce;
+	uint64_t nonce;
+#endif
+
+	account();
+	latency = code_end_us - reading_us[stats.readings % LATCH_LOG];
+
+#if SHARC_CIPHER == SHARC_CIPHER_RSA
+	len = ground_rsa_open(code, codelen, decoded, sizeof(decoded));
+#else
+	len = ground_open_frame(code, codelen, &nonce, decoded, sizeof(decoded));
+	// the ground station takes a nonce once: each is higher than the last, and is this block's
+	if (len >= 0 && ((uint16_t)nonce != (uint16_t)block_seq || (stats.blocks > 0 && nonce <= last_nonce))) {
+		fprintf(stderr, "block %lu has the nonce %llx\n", stats.blocks, (unsigned long long)nonce);
+		len = -1;
+	}
+	if (len >= 0) last_nonce = nonce;
+#endif
+	if (len != textlen || memcmp(decoded, text, len) != 0) {
+		fprintf(stderr, "block %lu does not decode to the readings sent\n", stats.blocks);
+		stats.failed++;
+	}
+	if (stats.blocks == 0) first_row = reading_row[stats.readings % LATCH_LOG];
+	if (stats.blocks == 0 || latency < stats.latency_min) stats.latency_min = latency;
+	if (latency > stats.latency_max) stats.latency_max = latency;
+	stats.latency_sum += latency;
+	stats.text_bytes += textlen;
+	stats.code_bytes += codelen;
+#if SHARC_RECORD == SHARC_RECORD_BINARY
+	(void)i;
+	stats.readings += textlen / SHARC_RECORD_LEN;
+#else
+	for (i = 0; i + 1 < textlen; i++) {
+		if (text[i] == '\r' && text[i + 1] == '\n') stats.readings++;	// main.c may cut off the ';'
+	}
+#endif
+	last_row = reading_row[(stats.readings - 1) % LATCH_LOG];
+	stats.blocks++;
+	in_code = 0;
+	textlen = 0;
+	block_seq++;
+	if (stats.blocks == max_blocks) longjmp(stop, 1);
+}
+
+/* the header is the first thing sent, once the sensor is set up */
+static void uart_started(const uint8_t *data, uint16_t size)
+{
+	(void)data;
+	(void)size;
+	if (!replaying) {
+		replaying = 1;
+		mock_icm20948_start_replay();
+		next_row = mock_icm20948_rows + 1;	// the first sample latches the next row
+		spi_busy0_us = hal_spi_busy_us;
+		spi_blocked0_us = hal_spi_blocked_us;
+	}
+}
+
+#if SHARC_LINK == SHARC_LINK_FRAMES
+static uint32_t get_le(const uint8_t *p, int n)
+{
+	uint32_t v = 0;
+
+	while (n--) v = v << 8 | p[n];
+	return v;
+}
+
+/* the figures of a status frame were read before it was sent: none can be ahead of the scheduler's */
+static void status_received(const struct frame *f)
+{
+	const uint8_t *p = f->payload + 5;
+	const struct sched_stats *st;
+	int i;
+
+	stats.status++;
+	if (f->len != FRAME_STATUS_LEN(sched.n) || f->payload[4] != sched.n || get_le(f->payload + 2, 2) > cpuLoadMax) {
+		stats.status_bad++;
+		return;
+	}
+	for (i = 0; i < sched.n; i++, p += FRAME_STATUS_TASK_LEN) {
+		st = &sched.stats[i];
+		if (get_le(p, 4) > st->runs || get_le(p + 4, 4) > st->busy_us || get_le(p + 8, 4) > st->max_run_us ||
+				get_le(p + 12, 4) > st->max_latency_us || get_le(p + 16, 2) > st->misses) {
+			stats.status_bad++;
+			return;
+		}
+	}
+}
+
+/* the ground station's view of the UART, one frame at a time */
+static void frame_received(const struct frame *f)
+{
+	switch (f->type) {
+	case FRAME_TYPE_READINGS:
+	case FRAME_TYPE_RECORDS:
+		textlen = f->len < TEXT_MAX ? f->len : TEXT_MAX;
+		memcpy(text, f->payload, textlen);
+		break;
+	case FRAME_TYPE_RSA:
+	case FRAME_TYPE_SEALED:
+		codelen = f->len < CODE_MAX ? f->len : CODE_MAX;
+		memcpy(code, f->payload, codelen);
+		block_seq = f->seq;	// the low 16 bits of the block number in the nonce
+		code_end_us = hal_time_us();
+		finish_block();
+		break;
+	case FRAME_TYPE_STATUS:
+		status_received(f);
+		break;
+	}
+}
+
+static void uart_received(const uint8_t *data, uint16_t size)
+{
+	struct frame f;
+	uint16_t i;
+
+	for (i = 0; i < size; i++) {
+		if (frame_parse(&parser, data[i], &f)) frame_received(&f);
+	}
+}
+#else
+/* the ground station's view of the UART, one HAL_UART_Transmit() at a time */
+static void uart_received(const uint8_t *data, uint16_t size)
+{
+	static int header_seen;
+	const char *end;
+
+	if (!header_seen) {
+		header_seen = 1;
+		return;
+	}
+	if (in_code && size <= 8 && data[0] == '\r' && data[1] == '\n') {
+		// "\r\n%d," in a fixed size buffer; the bytes after the comma are padding
+		if (codelen < CODE_MAX) code[codelen++] = (uint8_t)strtol((const char *)data + 2, NULL, 10);
+		code_end_us = hal_time_us();
+	} else if (size >= 3 && memcmp(data, "\r\n#", 3) == 0) {
+		in_code = 1;
+		codelen = 0;
+	} else if ((end = memchr(data, '}', size)) != NULL) {
+		// the next block's readings: the code before them is complete
+		if (in_code) finish_block();
+		textlen = end - (const char *)data;
+		if (textlen > TEXT_MAX) textlen = TEXT_MAX;
+		memcpy(text, data, textlen);
+	}
+}
+#endif
+
+/* the sensor latched a new row */
+static void sample(unsigned long row)
+{
+	account();
+	latch_us[row % LATCH_LOG] = hal_time_us();
+	if (replaying && hal_uart_sending()) stats.tx_samples++;
+}
+
+static void recording_end(void)
+{
+	longjmp(stop, 1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *csv_path = default_csv;
+	FILE *capture = NULL;
+	unsigned long bytes;
+	uint64_t duration_us, run_us, busy_us = 0, imu_us[MOCK_ICM20948_POWER_MODES];
+	double mcu_mc, compute_mc, imu_mc = 0;	// charge, mA s
+	int64_t clock_error_us;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "e:n:o:")) != -1) {
+		switch (opt) {
+		case 'e':
+			hal_uart_dma_fail_every = strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			max_blocks = strtoul(optarg, NULL, 10);
+			break;
+		case 'o':
+			if ((capture = fopen(optarg, "wb")) == NULL) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n blocks] [-o capture file] [-e n] [csv file]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (optind < argc) csv_path = argv[optind];
+	if (mock_icm20948_open(csv_path) != 0) {
+		fprintf(stderr, "cannot read readings from %s\n", csv_path);
+		return 1;
+	}
+	ground_init();
+#if SHARC_LINK == SHARC_LINK_FRAMES
+	frame_parser_init(&parser);
+#endif
+	hal_uart_capture = capture;
+	hal_uart_tx_start_hook = uart_started;
+	hal_uart_tx_hook = uart_received;
+	mock_icm20948_on_sample = sample;
+	mock_icm20948_on_end = recording_end;
+	hal_task_hook = task_started;
+
+	if (setjmp(stop) == 0) sharc_main();
+	// a block still on the air when the recording ran out is complete once its last byte is
+	if (in_code) finish_block();
+	duration_us = hal_time_us();
+	bytes = hal_uart_bytes;
+	clock_error_us = (int64_t)(uint32_t)duration_us - sched_time_us();
+	run_us = duration_us - hal_sleep_us - hal_stop_us;
+	mcu_mc = (run_us * MCU_RUN_MA + hal_sleep_us * MCU_SLEEP_MA + hal_stop_us * MCU_STOP_MA) / 1e6;
+	compute_mc = hal_compute_us * MCU_RUN_MA / 1e6;
+	for (i = 0; i < MOCK_ICM20948_POWER_MODES; i++) {
+		imu_us[i] = mock_icm20948_power_us(i);
+		imu_mc += imu_us[i] * imu_ma[i] / 1e6;
+	}
+	mock_icm20948_close();
+	if (capture != NULL) fclose(capture);
+
+	printf("cipher:                 %d\n", SHARC_CIPHER);
+	printf("link:                   %s\n", SHARC_LINK == SHARC_LINK_FRAMES ? "frames" : "text");
+	printf("records:                %s\n", SHARC_RECORD == SHARC_RECORD_BINARY ? "binary" : "text");
+	printf("power:                  %s\n", SHARC_POWER == SHARC_POWER_LOW ? "low" : "run");
+	printf("blocks:                 %lu (%lu failed)\n", stats.blocks, stats.failed);
+	printf("readings:               %lu\n", stats.readings);
+	printf("rows replayed:          %lu\n", mock_icm20948_rows);
+	printf("reading bytes:          %lu\n", stats.text_bytes);
+	printf("payload bytes:          %lu\n", stats.code_bytes);
+	printf("bytes on air:           %lu\n", bytes);
+	if (stats.readings > 0) {
+		printf("bytes on air / reading: %.1f\n", (double)bytes / stats.readings);
+	}
+	printf("virtual time:           %.3f s\n", duration_us / 1e6);
+	if (duration_us > 0) {
+		printf("readings / s:           %.3f\n", stats.readings * 1e6 / duration_us);
+	}
+	if (stats.blocks > 0) {
+		printf("block latency:          %.3f / %.3f / %.3f s (min / avg / max)\n",
+				stats.latency_min / 1e6, stats.latency_sum / 1e6 / stats.blocks, stats.latency_max / 1e6);
+	}
+	printf("spi transactions:       %lu\n", mock_icm20948_transactions);
+	if (hal_spi_busy_us > spi_busy0_us) {
+		printf("cpu free while on spi:  %.1f %%\n", 100.0 * (1 - (double)(hal_spi_blocked_us - spi_blocked0_us) /
+				(hal_spi_busy_us - spi_busy0_us)));
+	}
+	printf("dma channel conflicts:  %lu\n", hal_dma_conflicts);
+	printf("samples dropped:        %u\n", sampleRing.dropped);
+	if (stats.readings > 0) {
+		printf("sample duty cycle:      %.1f %%\n", 100.0 * stats.readings / (last_row - first_row + 1));
+	}
+	printf("uart on air:            %.3f s\n", hal_uart_busy_us / 1e6);
+	if (hal_uart_busy_us > 0) {
+		printf("cpu free while on air:  %.1f %%\n",
+				100.0 * (hal_uart_busy_us - hal_uart_blocked_us) / hal_uart_busy_us);
+	}
+	printf("samples read on air:    %lu\n", stats.tx_samples);
+	printf("frame buffer waits:     %lu\n", txWaits);
+	printf("frame start retries:    %lu\n", txRetries);
+	printf("%-22s %6s %8s %11s %11s %7s\n", "task", "runs", "busy s", "max run ms", "max lat ms", "misses");
+	for (i = 0; i < sched.n; i++) {
+		const struct sched_stats *st = &sched.stats[i];
+		printf("%-22s %6u %8.3f %11.3f %11.3f %7u\n", sched.tasks[i].name, st->runs, st->busy_us / 1e6,
+				st->max_run_us / 1e3, st->max_latency_us / 1e3, st->misses);
+		busy_us += st->busy_us;
+	}
+	printf("cpu load:               %.1f %% (busiest period %.1f %%)\n", 100.0 * busy_us / duration_us, cpuLoadMax / 10.0);
+	printf("mcu compute, modelled:  %.3f s\n", hal_compute_us / 1e6);
+	printf("mcu run/sleep/stop:     %.1f / %.1f / %.1f %%\n", 100.0 * run_us / duration_us,
+			100.0 * hal_sleep_us / duration_us, 100.0 * hal_stop_us / duration_us);
+	printf("imu low-noise/low-power/sleep: %.1f / %.1f / %.1f %%\n", 100.0 * imu_us[MOCK_ICM20948_LOW_NOISE] / duration_us,
+			100.0 * imu_us[MOCK_ICM20948_LOW_POWER] / duration_us, 100.0 * imu_us[MOCK_ICM20948_SLEEP] / duration_us);
+	printf("average current:        %.3f mA (mcu %.3f, imu %.3f)\n", (mcu_mc + imu_mc) * 1e6 / duration_us,
+			mcu_mc * 1e6 / duration_us, imu_mc * 1e6 / duration_us);
+	if (stats.readings > 0) {
+		printf("energy / reading:       %.3f mJ (mcu %.3f, of it compute %.3f, imu %.3f)\n",
+				(mcu_mc + imu_mc) * SUPPLY_V / stats.readings, mcu_mc * SUPPLY_V / stats.readings,
+				compute_mc * SUPPLY_V / stats.readings, imu_mc * SUPPLY_V / stats.readings);
+	}
+	printf("clock error:            %.3f ms\n", clock_error_us / 1e3);
+	printf("stop with dma running:  %lu\n", hal_stop_dma_errors);
+	printf("accel/gyro rate differ: %lu\n", mock_icm20948_rate_mismatches);
+#if SHARC_LINK == SHARC_LINK_FRAMES
+	printf("frame errors:           %lu\n", parser.errors);
+	printf("status frames:          %lu (%lu wrong)\n", stats.status, stats.status_bad);
+	if (parser.errors > 0 || stats.status_bad > 0) return 1;
+#endif
+	return stats.failed > 0 || stats.blocks == 0 || hal_dma_conflicts > 0 || hal_stop_dma_errors > 0 ||
+			mock_icm20948_rate_mismatches > 0;
+}
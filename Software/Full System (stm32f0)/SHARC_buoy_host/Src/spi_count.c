@@ -0,0 +1,228 @@
+/*
+ * spi_count.c
+ *
+ * Counts the SPI traffic of the SHARC_buoy firmware's ICM-20948 driver. The driver in
+ * main.c talks to the mock ICM-20948 through the stub HAL, which counts every chip
+ * select cycle (transaction) and every byte clocked; the bus time follows from the bytes
+ * at HAL_SPI_HZ.
+ *
+ * Reported are the sensor set-up (icm20948_init(), with its calibration), the calibration
+ * on its own and one sample read each way the driver can read it, with the number of
+ * those transactions that only select a user bank and the sensor rows each one spans.
+ * icm20948_read_raw() + icm20948_convert() is checked to convert the counts of the sample
+ * it read, and to take at most half the bus time of the raw + scaled reads the main loop
+ * made before.
+ *
+ * Last, the FIFO: the sensor samples at FIFO_ODR_DIV and the MCU waits (sleeps, on the
+ * board) while FIFO_BATCH samples collect, then drains them with icm20948_fifo_read().
+ * Reported are the samples per SPI transaction and the time the MCU is awake per sample,
+ * against polling the output registers at the same rate. Every sample the sensor took
+ * must come out of the FIFO. The sample reads are also checked to return the
+ * same counts from the same sensor row.
+ *
+ * Usage: spi_count [samples] [csv file]
+ * The csv file must have the "Accel X (g),...,Gyro Z (dps)" columns of the files in
+ * Testing/Simulation Data/Cleaned Data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "hal_stub.h"
+#include "mock_icm20948.h"
+
+/* firmware state (main.c) */
+extern SPI_HandleTypeDef hspi2;
+
+static const char *default_csv = "../../../Testing/Simulation Data/Cleaned Data/Walking Around Example Data.csv";
+
+/* counts per g and per dps at the full scales icm20948_init() selects (2 g, 2000 dps) */
+#define ACCEL_SCALE 16384.0f
+#define GYRO_SCALE 16.4f
+
+static icm20948_sample s;
+static icm20948_raw raw;
+
+/* icm20948_accel_read() and icm20948_gyro_read(): twelve single register reads */
+static void read_separate(void)
+{
+	icm20948_accel_read(&s.accel);
+	icm20948_gyro_read(&s.gyro);
+}
+
+/* the main loop's reads before the burst: raw, then scaled, each read separately */
+static void read_raw_and_scaled(void)
+{
+	icm20948_accel_read(&s.accel);
+	icm20948_gyro_read(&s.gyro);
+	icm20948_gyro_read_dps(&s.gyro_dps);
+	icm20948_accel_read_g(&s.accel_g);
+}
+
+/* icm20948_read_raw(): one burst, then icm20948_convert() */
+static void read_burst(void)
+{
+	icm20948_read_raw(&raw);
+	icm20948_convert(&raw, &s);
+}
+
+static const struct {
+	const char *name;
+	void (*read)(void);
+} paths[] = {
+	{ "accel_read + gyro_read", read_separate },
+	{ "raw + scaled reads", read_raw_and_scaled },
+	{ "read_raw + convert", read_burst },
+};
+
+#define PATHS (sizeof(paths) / sizeof(paths[0]))
+#define RAW_AND_SCALED 1
+#define BURST 2
+
+/* 1 if the values in g and dps are the raw counts of the same sample, converted */
+static int coherent(const icm20948_sample *x)
+{
+	return x->accel_g.x == x->accel.x / ACCEL_SCALE && x->accel_g.y == x->accel.y / ACCEL_SCALE &&
+			x->accel_g.z == x->accel.z / ACCEL_SCALE && x->gyro_dps.x == x->gyro.x / GYRO_SCALE &&
+			x->gyro_dps.y == x->gyro.y / GYRO_SCALE && x->gyro_dps.z == x->gyro.z / GYRO_SCALE;
+}
+
+#define FIFO_ODR_DIV 10	// 1125 Hz / (1 + 10) = 102.3 Hz
+#define FIFO_BATCH 40	// samples collected between drains; the FIFO holds 42
+#define FIFO_MAX (ICM20948_FIFO_SIZE / ICM20948_FIFO_SAMPLE_LEN)
+
+static icm20948_raw fifo_raw[FIFO_MAX];
+
+static unsigned long t0, b0, s0, r0;
+
+static void start(void)
+{
+	t0 = mock_icm20948_transactions;
+	b0 = mock_icm20948_bytes;
+	s0 = mock_icm20948_bank_selects;
+	r0 = mock_icm20948_rows;
+}
+
+/* prints the traffic since start(), per call for n calls, and returns the bus time per call */
+static double report(const char *name, unsigned long n)
+{
+	unsigned long bytes = mock_icm20948_bytes - b0;
+	double bus_us = bytes * 8e6 / HAL_SPI_HZ / n;
+
+	printf("%-28s %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, (double)(mock_icm20948_transactions - t0) / n,
+			(double)(mock_icm20948_bank_selects - s0) / n, (double)bytes / n, bus_us,
+			(double)(mock_icm20948_rows - r0) / n);
+	return bus_us;
+}
+
+static void heading(const char *name)
+{
+	printf("%-28s %8s %8s %8s %8s %8s\n", name, "trans", "bank sel", "bytes", "bus us", "rows");
+}
+
+/* drains FIFO_BATCH samples at a time until at least samples are read; returns 0 if none were lost */
+static int fifo_drains(unsigned long samples)
+{
+	double period_us = (1 + FIFO_ODR_DIV) * 1e6 / 1125;
+	unsigned long n = 0, transactions, rows;
+	double bus_us;
+	icm20948_raw last;
+	int k = 0, failed = 0;
+
+	icm20948_gyro_sample_rate_divider(FIFO_ODR_DIV);
+	icm20948_accel_sample_rate_divider(FIFO_ODR_DIV);
+	icm20948_fifo_enable();
+
+	start();
+	while (n < samples) {
+		HAL_Delay((uint32_t)(FIFO_BATCH * period_us / 1000));	// the MCU would sleep here
+		k = icm20948_fifo_read(fifo_raw, FIFO_MAX);
+		n += k;
+	}
+	transactions = mock_icm20948_transactions - t0;
+	rows = mock_icm20948_rows - r0;
+	heading("spi per sample, fifo");
+	bus_us = report("fifo_read", n);
+
+	printf("fifo at %.1f Hz, drained every %d samples\n", 1e6 / period_us, FIFO_BATCH);
+	printf("samples per transaction:     %8.1f (read_raw: 1.0)\n", (double)n / transactions);
+	printf("mcu awake us per sample:     %8.1f (read_raw polled: %.1f)\n", bus_us, period_us);
+
+	// every sample taken is read, and the output registers hold the last one drained
+	icm20948_read_raw(&last);
+	if (rows != n || mock_icm20948_fifo_overflows != 0) {
+		fprintf(stderr, "the fifo lost samples: %lu taken, %lu read, %lu dropped\n", rows, n,
+				mock_icm20948_fifo_overflows);
+		failed = 1;
+	} else if (k == 0 || memcmp(&last, &fifo_raw[k - 1], sizeof(last)) != 0) {
+		fprintf(stderr, "the last sample read from the fifo is not the sensor's last\n");
+		failed = 1;
+	}
+	icm20948_fifo_disable();
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *csv_path = default_csv;
+	unsigned long samples = 100;
+	icm20948_sample first;
+	double bus_us[PATHS];
+	unsigned i, j;
+	int failed = 0;
+
+	if (argc > 1) samples = strtoul(argv[1], NULL, 10);
+	if (argc > 2) csv_path = argv[2];
+	if (samples == 0 || mock_icm20948_open(csv_path) != 0) {
+		fprintf(stderr, "usage: %s [samples] [csv file]\n", argv[0]);
+		return 1;
+	}
+
+	HAL_Init();
+	hspi2.Instance = SPI2;	// MX_SPI2_Init() is static to main.c
+
+	heading("spi per call");
+	start();
+	icm20948_init();
+	report("icm20948_init", 1);
+	start();
+	icm20948_gyro_calibration();
+	icm20948_accel_calibration();
+	report("gyro + accel calibration", 1);
+
+	// the mock holds one row until replay starts: every path must read the same counts
+	for (i = 0; i < PATHS; i++) {
+		paths[i].read();
+		if (i == 0) first = s;
+		if (memcmp(&s.accel, &first.accel, sizeof(axises)) != 0 || memcmp(&s.gyro, &first.gyro, sizeof(axises)) != 0) {
+			fprintf(stderr, "%s does not read the counts of %s\n", paths[i].name, paths[0].name);
+			failed = 1;
+		}
+	}
+
+	mock_icm20948_start_replay();
+	heading("spi per sample");
+	for (i = 0; i < PATHS; i++) {
+		start();
+		for (j = 0; j < samples; j++) {
+			paths[i].read();
+			if (i == BURST && !coherent(&s)) {
+				fprintf(stderr, "sample %u of %s: the values in g and dps are not its counts\n", j, paths[i].name);
+				failed = 1;
+			}
+		}
+		bus_us[i] = report(paths[i].name, samples);
+	}
+	printf("burst / raw + scaled reads: %.2f of the bus time\n", bus_us[BURST] / bus_us[RAW_AND_SCALED]);
+	if (bus_us[BURST] > bus_us[RAW_AND_SCALED] / 2) {
+		fprintf(stderr, "the burst takes more than half the bus time of the raw + scaled reads\n");
+		failed = 1;
+	}
+
+	failed |= fifo_drains(samples);
+
+	mock_icm20948_close();
+	return failed;
+}
@@ -0,0 +1,153 @@
+"""
+    This script is used for reading the binary frames sent by the stm32f0 when it is built with
+    SHARC_LINK_FRAMES (see SHARC_buoy/Core/Inc/frame.h). It replaces clean.py for that link:
+    the frames are checked (CRC, length, sequence number) and written to the same files clean.py
+    writes, so the decompression and decryption steps do not change.
+
+    Usage: python3 frames.py [capture file]
+    The capture file is the raw serial data, e.g. saved by serialReceive.py.
+"""
+import re
+import struct
+import sys
+
+# Frame types (frame.h)
+FRAME_TYPE_HEADER = 0x01
+FRAME_TYPE_READINGS = 0x02
+FRAME_TYPE_RSA = 0x03
+FRAME_TYPE_SEALED = 0x04
+FRAME_TYPE_RECORDS = 0x05
+FRAME_TYPE_STATUS = 0x06
+
+# the tasks of a status frame, in the order of schedTasks in main.c
+TASK_NAMES = ["sampling", "compression", "crypto", "transmission", "housekeeping"]
+STATUS_TASK_LEN = 18
+
+FRAME_HEADER_LEN = 5
+FRAME_CRC_LEN = 2
+
+#Functions
+
+def crc16(data):
+    # CRC-16/CCITT-FALSE
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            return None
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+def f32(x):
+    # the stm32f0 computes the readings in single precision
+    return struct.unpack('<f', struct.pack('<f', x))[0]
+
+def records_to_text(payload, header):
+    """ binary records (SHARC_RECORD_BINARY) as the text readings the stm32f0 would have sent """
+    scales = [f32(float(s)) for s in re.findall(r'/([0-9.]+)\)', header)]   # counts per g and per dps
+    recordLen = 14 if 'dt (ms)' in header else 12
+    lines = []
+    for i in range(0, len(payload) - recordLen + 1, recordLen):
+        counts = struct.unpack_from('<6h', payload, i)
+        values = [f32(f32(c) / scales[k]) for k, c in enumerate(counts)]
+        lines.append(",".join("%.2f" % v for v in values) + ";")
+    return lines
+
+def status_to_text(payload):
+    """ a status frame (send_status() in main.c) as text, or None if it is not one """
+    if len(payload) < 5 or len(payload) != 5 + payload[4] * STATUS_TASK_LEN:
+        return None
+    load, loadMax, tasks = struct.unpack_from('<HHB', payload, 0)
+    lines = ["cpu load %.1f %%, busiest period %.1f %%" % (load / 10, loadMax / 10)]
+    for i in range(tasks):
+        runs, busy, maxRun, maxLatency, misses = struct.unpack_from('<IIIIH', payload, 5 + i * STATUS_TASK_LEN)
+        name = TASK_NAMES[i] if i < len(TASK_NAMES) else "task %d" % i
+        lines.append("%-12s %d runs, %.3f s busy, %.3f ms longest run, %.3f ms longest latency, %d deadline misses"
+                     % (name, runs, busy / 1e6, maxRun / 1e3, maxLatency / 1e3, misses))
+    return "\n".join(lines)
+
+def parse_frames(stream):
+    """ returns (type, sequence number, payload) of every good frame, and the number of bad ones """
+    frames = []
+    errors = 0
+    for chunk in stream.split(b'\x00'):
+        if not chunk:
+            continue
+        frame = cobs_decode(chunk)
+        if frame is None or len(frame) < FRAME_HEADER_LEN + FRAME_CRC_LEN:
+            errors += 1
+            continue
+        length = frame[3] | frame[4] << 8
+        crc = frame[-2] | frame[-1] << 8
+        if length != len(frame) - FRAME_HEADER_LEN - FRAME_CRC_LEN or crc16(frame[:-FRAME_CRC_LEN]) != crc:
+            errors += 1
+            continue
+        frames.append((frame[0], frame[1] | frame[2] << 8, frame[FRAME_HEADER_LEN:-FRAME_CRC_LEN]))
+    return frames, errors
+
+def main():
+    captureFile = sys.argv[1] if len(sys.argv) > 1 else "enc_comp.bin"
+    sensorDataFile = "sensor_data.txt"
+    compressedDataFile = "compressed_data.txt"
+
+    with open(captureFile, "rb") as f:
+        stream = f.read()
+
+    sensorData = []                 # real sensor data
+    compressedData = []             # real compressed bytes, signed like the text link sends them
+    lastSeq = None
+    header = ""
+    status = None                   # the last status frame, as text
+    frames, errors = parse_frames(stream)
+    for frameType, seq, payload in frames:
+        if frameType == FRAME_TYPE_HEADER:
+            header = payload.decode('ascii')
+        elif frameType == FRAME_TYPE_READINGS:
+            sensorData += [line for line in payload.decode('ascii').split("\r\n") if line]
+        elif frameType == FRAME_TYPE_RECORDS:
+            sensorData += records_to_text(payload, header)
+        elif frameType in (FRAME_TYPE_RSA, FRAME_TYPE_SEALED):
+            if lastSeq is not None and seq != (lastSeq + 1) & 0xFFFF:
+                print("blocks %d to %d are missing" % ((lastSeq + 1) & 0xFFFF, (seq - 1) & 0xFFFF))
+            lastSeq = seq
+            compressedData += [b - 256 if b > 127 else b for b in payload]
+        elif frameType == FRAME_TYPE_STATUS:
+            text = status_to_text(payload)
+            if text is None:
+                errors += 1
+            else:
+                status = text
+
+    f = open(sensorDataFile, "a")
+    for x in sensorData:
+        f.write("\n")
+        f.write(x)
+    f.close()
+
+    f = open(compressedDataFile, "a")
+    f.write("\n".join(str(y) for y in compressedData))
+    f.close()
+
+    print(sensorData)
+    print(compressedData)
+    print("%d readings, %d compressed bytes, %d bad frames" % (len(sensorData), len(compressedData), errors))
+    if status is not None:
+        print(status)
+
+
+if __name__ == "__main__":
+    main()
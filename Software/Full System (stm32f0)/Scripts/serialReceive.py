@@ -28,7 +28,7 @@ while(1):
             # Print the contents of the serial data
         with open(file,"ab") as f:
             f.write(serialString)
-            print(serialString.decode('Ascii'))
+            print(serialString.decode('Ascii', errors='replace')) # binary with SHARC_LINK_FRAMES
             f.close()
        # os.system(compileCMD)
        # os.system(runCMD)
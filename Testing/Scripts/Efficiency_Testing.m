@@ -1,10 +1,45 @@
 %PLOT EFFICIENCY GRAPHS
-characters = [0,36, 179, 360, 545, 730];
-comp = [0,6,31,63,97,135];
-enc = [0,0,1,3,4,5];
+%from the pipeline benchmark: in ChaCha20Poly1305V2/ run ./bench --csv > ../../../Testing/Scripts/bench.csv
+fid = fopen("bench.csv");
+fgetl(fid); %header
+data = textscan(fid, "%s %s %f %f %f %f %f %f", "Delimiter", ",");
+fclose(fid);
+stage = data{1}; dataset = data{2}; ratio = data{5}; nsPerByte = data{6};
 
-plot(characters, comp, "-.", color="k");
+%time per character of every stage, one group of bars per dataset
+stages = unique(stage, "stable");
+datasets = unique(dataset, "stable");
+t = zeros(numel(stages), numel(datasets));
+r = zeros(1, numel(datasets));
+for i = 1:numel(stage)
+    t(strcmp(stages, stage{i}), strcmp(datasets, dataset{i})) = nsPerByte(i);
+    if strcmp(stage{i}, "pipeline_seal")
+        r(strcmp(datasets, dataset{i})) = ratio(i);
+    end
+end
+figure
+bar(t)
+set(gca, "xticklabel", stages)
+ylabel("ns/byte")
+legend(datasets)
+
+%the original graph: time against characters for compression, encryption and both
+characters = [0, 36, 179, 360, 545, 730];
+stm32 = strcmp(datasets, "STM32ArrayData.csv");
+comp = characters * t(strcmp(stages, "lzss_encode"), stm32) / 1e6;
+enc = characters * t(strcmp(stages, "rsa"), stm32) / 1e6;
+figure
+plot(characters, comp, "-.", "color", "k");
 hold on
-plot(characters, enc, "--", color="k");
+plot(characters, enc, "--", "color", "k");
 hold on
-plot(characters, comp+enc, "-", color="k")
\ No newline at end of file
+plot(characters, comp + enc, "-", "color", "k")
+xlabel("characters")
+ylabel("ms")
+legend("compression", "encryption", "compression + encryption")
+
+%compression ratio of the sealed pipeline
+figure
+bar(r)
+set(gca, "xticklabel", datasets)
+ylabel("sealed bytes / input bytes")
@@ -0,0 +1,26 @@
+%PLOT THROUGHPUT AGAINST BLOCK SIZE
+%from the size sweep: in ChaCha20Poly1305V2/ run ./bench --sweep > ../../../Testing/Scripts/sweep.csv
+fid = fopen("sweep.csv");
+fgetl(fid); %header
+data = textscan(fid, "%s %f %f %f %f %f %f %f", "Delimiter", ",");
+fclose(fid);
+stage = data{1}; bytes = data{2}; mbPerS = data{5}; crossover = data{8};
+
+stages = unique(stage, "stable");
+figure
+for i = 1:numel(stages)
+    rows = strcmp(stage, stages{i});
+    h = semilogx(bytes(rows), mbPerS(rows), "-o");
+    hold on
+    %the crossover: below it the fixed cost of a call is more than half of the time
+    c = crossover(find(rows, 1));
+    if c > 0
+        semilogx([c, c], [0, max(mbPerS(rows))], ":", "color", get(h, "color"));
+    end
+end
+%a buoy reading and a firmware block
+semilogx([37, 37], ylim, "--", "color", "k");
+semilogx([400, 400], ylim, "--", "color", "k");
+xlabel("block size (bytes)")
+ylabel("MB/s")
+legend(stages)